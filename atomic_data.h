@@ -22,10 +22,33 @@ methods:
   - auto read( F )
   where F - a functor which accepts a pointer to data type and returns the return value of the functor or void
 
+  - guard
+  - auto read( guard const&, F )
+  a read-side critical section that spans several reads: the data read with read( guard, F ) stays valid
+  (is not reused by writers) until the guard is destroyed, across all instances of the data type
+  (the queue is per type), so a raw pointer to data_type or into it can be used for the guard lifetime
+  writers wait for guards at the sync barrier: keep them short and don't call update for the same
+  data type under a guard (update_weak fails instead)
+
   - data_type* operator->() = delete;
   - data_type& operator*() = delete;
   getting the raw pointer to wrapped data is undesired because it changes on every update call
 
+customization:
+
+  - void atomic_data_copy( data_type& dst, data_type const& src )
+  update_weak brings a queue element up to date with the current data
+  by calling atomic_data_copy, by default it is dst = src
+  trivially copyable types of ATOMIC_DATA_COPY_THRESHOLD bytes and bigger (16K by default) are copied
+  by a kernel selected at runtime (AVX-512/AVX2 on x86 with GCC/Clang, memcpy elsewhere) that prefetches
+  the source and uses non-temporal stores from ATOMIC_DATA_STREAM_THRESHOLD bytes on (1M by default)
+  overload it for your data type (found by ADL) if an object can be updated cheaper than by
+  a full copy assignment (reuse memory, share immutable parts)
+  atomic_data_std.h (opt-in, include it before the first use of atomic_data with the containers)
+  has copies for std::vector, std::basic_string, std::map and std::unordered_map: they reuse the
+  memory already owned by dst and copy element-wise with atomic_data_copy
+  the copy constructor and the copy assignment of atomic_data copy construct data_type
+
 License: Public-domain Software.
 
 More is in the blog post: http://alexpolt.github.io/atomic-data.html
@@ -34,6 +57,179 @@ Alexandr Poltavsky
 
 #include <atomic>
 #include <thread>
+#include <type_traits>
+#include <cstring>
+#include <cstdint>
+
+#if ( defined( __GNUC__ ) || defined( __clang__ ) ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#include <immintrin.h>
+#define ATOMIC_DATA_X86_COPY
+#endif
+
+//trivially copyable data types of this size and bigger are copied with the large copy kernel
+#ifndef ATOMIC_DATA_COPY_THRESHOLD
+#define ATOMIC_DATA_COPY_THRESHOLD 16384
+#endif
+
+//the large copy kernel uses non-temporal stores from this size on (the copy doesn't fit in the cache anyway)
+#ifndef ATOMIC_DATA_STREAM_THRESHOLD
+#define ATOMIC_DATA_STREAM_THRESHOLD 1048576
+#endif
+
+
+//Copy Customization Point
+//declared before defined to make it visible to the element-wise copies of containers
+template< typename T0 >
+void atomic_data_copy( T0& dst, T0 const& src );
+
+namespace atomic_data_detail {
+
+  using size_t = std::size_t;
+
+#ifdef ATOMIC_DATA_X86_COPY
+
+  //Large Copy Kernel
+  //aligns the destination, prefetches the source ahead and copies with full width vector stores
+  //non-temporal stores are used for copies that don't fit in the cache
+
+  const size_t prefetch_distance = 1024;
+
+  template< bool stream >
+  __attribute__(( target( "avx2" ) ))
+  void copy_avx2_blocks( char* dst, char const* src, size_t blocks ) {
+    for( ; blocks; blocks--, dst += 128, src += 128 ) {
+      _mm_prefetch( src + prefetch_distance, _MM_HINT_T0 );
+      _mm_prefetch( src + prefetch_distance + 64, _MM_HINT_T0 );
+      __m256i r0 = _mm256_loadu_si256( (__m256i const*) src );
+      __m256i r1 = _mm256_loadu_si256( (__m256i const*) ( src + 32 ) );
+      __m256i r2 = _mm256_loadu_si256( (__m256i const*) ( src + 64 ) );
+      __m256i r3 = _mm256_loadu_si256( (__m256i const*) ( src + 96 ) );
+      if( stream ) {
+        _mm256_stream_si256( (__m256i*) dst, r0 );
+        _mm256_stream_si256( (__m256i*) ( dst + 32 ), r1 );
+        _mm256_stream_si256( (__m256i*) ( dst + 64 ), r2 );
+        _mm256_stream_si256( (__m256i*) ( dst + 96 ), r3 );
+      } else {
+        _mm256_store_si256( (__m256i*) dst, r0 );
+        _mm256_store_si256( (__m256i*) ( dst + 32 ), r1 );
+        _mm256_store_si256( (__m256i*) ( dst + 64 ), r2 );
+        _mm256_store_si256( (__m256i*) ( dst + 96 ), r3 );
+      }
+    }
+  }
+
+  template< bool stream >
+  __attribute__(( target( "avx512f" ) ))
+  void copy_avx512_blocks( char* dst, char const* src, size_t blocks ) {
+    for( ; blocks; blocks--, dst += 256, src += 256 ) {
+      _mm_prefetch( src + prefetch_distance, _MM_HINT_T0 );
+      _mm_prefetch( src + prefetch_distance + 64, _MM_HINT_T0 );
+      _mm_prefetch( src + prefetch_distance + 128, _MM_HINT_T0 );
+      _mm_prefetch( src + prefetch_distance + 192, _MM_HINT_T0 );
+      __m512i r0 = _mm512_loadu_si512( src );
+      __m512i r1 = _mm512_loadu_si512( src + 64 );
+      __m512i r2 = _mm512_loadu_si512( src + 128 );
+      __m512i r3 = _mm512_loadu_si512( src + 192 );
+      if( stream ) {
+        _mm512_stream_si512( (__m512i*) dst, r0 );
+        _mm512_stream_si512( (__m512i*) ( dst + 64 ), r1 );
+        _mm512_stream_si512( (__m512i*) ( dst + 128 ), r2 );
+        _mm512_stream_si512( (__m512i*) ( dst + 192 ), r3 );
+      } else {
+        _mm512_store_si512( dst, r0 );
+        _mm512_store_si512( dst + 64, r1 );
+        _mm512_store_si512( dst + 128, r2 );
+        _mm512_store_si512( dst + 192, r3 );
+      }
+    }
+  }
+
+  using copy_blocks_t = void (*)( char*, char const*, size_t );
+
+  struct copy_kernel {
+    size_t width;
+    copy_blocks_t store;
+    copy_blocks_t stream;
+  };
+
+  //runtime dispatch, done once
+  inline copy_kernel const& copy_kernel_select() {
+    static copy_kernel const kernel = []() -> copy_kernel {
+      __builtin_cpu_init();
+      if( __builtin_cpu_supports( "avx512f" ) ) return { 256, copy_avx512_blocks<false>, copy_avx512_blocks<true> };
+      if( __builtin_cpu_supports( "avx2" ) ) return { 128, copy_avx2_blocks<false>, copy_avx2_blocks<true> };
+      return { 0, nullptr, nullptr };
+    }();
+    return kernel;
+  }
+
+  inline void copy_large( void* dst_, void const* src_, size_t size ) {
+
+    copy_kernel const& kernel = copy_kernel_select();
+
+    if( ! kernel.width ) {
+      std::memcpy( dst_, src_, size );
+      return;
+    }
+
+    char* dst = (char*) dst_;
+    char const* src = (char const*) src_;
+
+    //align the destination to the store width (64 bytes at most, a cache line)
+    size_t align = kernel.width / 4;
+    size_t head = ( align - ( (std::uintptr_t) dst & ( align - 1 ) ) ) & ( align - 1 );
+    if( head > size ) head = size;
+    std::memcpy( dst, src, head );
+    dst += head, src += head, size -= head;
+
+    size_t blocks = size / kernel.width;
+    bool stream = size >= ATOMIC_DATA_STREAM_THRESHOLD;
+    ( stream ? kernel.stream : kernel.store )( dst, src, blocks );
+    if( stream ) _mm_sfence();
+
+    size_t done = blocks * kernel.width;
+    std::memcpy( dst + done, src + done, size - done );
+  }
+
+#else
+
+  inline void copy_large( void* dst, void const* src, size_t size ) {
+    std::memcpy( dst, src, size );
+  }
+
+#endif
+
+  template< typename T0 >
+  void copy_object( T0& dst, T0 const& src, std::false_type ) {
+    dst = src;
+  }
+
+  template< typename T0 >
+  void copy_object( T0& dst, T0 const& src, std::true_type ) {
+    if( &dst != &src ) copy_large( &dst, &src, sizeof( T0 ) );
+  }
+
+  template< typename T0 >
+  using is_large_trivial = std::integral_constant< bool, std::is_trivially_copyable<T0>::value && sizeof( T0 ) >= ATOMIC_DATA_COPY_THRESHOLD >;
+
+}
+
+//the default of atomic_data_copy: copy assignment, large trivially copyable types go through the
+//large copy kernel
+//a class template, so specializations for types whose overloads ADL can't find (std containers,
+//atomic_data_std.h) are picked up when the copy is instantiated
+template< typename T0, typename = void >
+struct atomic_data_copier {
+  static void copy( T0& dst, T0 const& src ) {
+    atomic_data_detail::copy_object( dst, src, atomic_data_detail::is_large_trivial<T0>{ } );
+  }
+};
+
+template< typename T0 >
+void atomic_data_copy( T0& dst, T0 const& src ) {
+  atomic_data_copier<T0>::copy( dst, src );
+}
+
 
 template< typename T0, unsigned N0 = 8 >
 struct atomic_data {
@@ -123,7 +319,7 @@ struct atomic_data {
   bool update_weak( U0 fn ) {
 
     auto queue_left = left.load();
-    auto queue_right = right.load();
+    auto queue_right = right.load( std::memory_order_seq_cst );
 
     //if the queue is full, back out
     if( queue_left == queue_right ) {
@@ -145,7 +341,7 @@ struct atomic_data {
     deallocate_guard dalloc{ data_new };
 
     //copy, atomic_data{ nullptr } is allowed
-    *data_new = *data_old;
+    atomic_data_copy( *data_new, *data_old );
 
     //update
     if( ! fn( data_new ) ) return false;
@@ -225,9 +421,9 @@ struct atomic_data {
   struct counter_t {
 
     uint get() { return index.load(); }
-    void inc( uint queue_right ) { counters[ counter_index( queue_right ) ].add( 1 ); }
+    void inc( uint queue_right ) { counters[ counter_index( queue_right ) ].add( 1, std::memory_order_seq_cst ); }
     void dec( uint queue_right ) { counters[ counter_index( queue_right ) ].sub( 1 ); }
-    bool is_used( uint queue_right ) { return counters[ 1 - counter_index( queue_right ) ].load() > 0; }
+    bool is_used( uint queue_right ) { return counters[ 1 - counter_index( queue_right ) ].load( std::memory_order_seq_cst ) > 0; }
 
     //based on the queue right pointer get the right counter
     uint counter_index( uint queue_right ) {
@@ -241,9 +437,20 @@ struct atomic_data {
   };
 
   //Usage Counter RAII Helper 
+  //the counter must be taken in the half that right points to after the increment: if right has
+  //moved to the other half meanwhile, the sync barrier might have checked the counter before it
+  //it's a store-load handshake with the writers: a reader increments the counter and then loads
+  //right, a writer moves right (deallocate_guard) and the one at the barrier loads right and then
+  //the counter, all of them seq_cst: either the reader sees the new half and retries or the writer
+  //sees the reader
   struct  counter_guard {
-    counter_guard() : queue_right{ right.load() } {
-      counter_usage.inc( queue_right );
+    counter_guard() {
+      while( true ) {
+        queue_right = right.load();
+        counter_usage.inc( queue_right );
+        if( counter_usage.counter_index( right.load( std::memory_order_seq_cst ) ) == counter_usage.counter_index( queue_right ) ) break;
+        counter_usage.dec( queue_right );
+      }
     }
     ~counter_guard() {
       counter_usage.dec( queue_right );
@@ -251,6 +458,17 @@ struct atomic_data {
     uint queue_right;
   };
 
+  //Read Guard
+  //the counter makes writers wait at the sync barrier before reusing the queue elements that were
+  //current data while it was held (they are returned to the queue after the counter was taken)
+  using guard = counter_guard;
+
+  //Read Within a Guard
+  template< typename U0 >
+  auto read( guard const&, U0 fn ) const -> decltype( fn( ( T0* ) nullptr ) ) {
+    return fn( data.load() );
+  }
+
   //Helper to Return an Allocated Element to the Queue
   struct deallocate_guard {
 
@@ -258,7 +476,7 @@ struct atomic_data {
 
       ~deallocate_guard() {
       //returning to the queue is just and atomic inc
-      queue[ right.add( 1 ) % array_size ] = data;
+      queue[ right.add( 1, std::memory_order_seq_cst ) % array_size ] = data;
 
       //unrequired on X86 but essential on ARM and other weakly ordered CPUS
       std::atomic_thread_fence( std::memory_order_release );
@@ -0,0 +1,251 @@
+#pragma once
+
+/*
+
+Per-slot arenas for atomic_data.
+
+atomic_data keeps a queue of preallocated T objects and every update copies the current
+data into one of them ( *data_new = *data_old ). For node based containers like std::map
+that copy frees and allocates every node through the global heap.
+
+arena_slot wraps such a container and gives every instance (and hence every queue slot)
+its own monotonic arena that the container allocator draws from. On copy the arena is
+rewound and the nodes are laid out again in the same memory, so in a steady state
+updates don't call malloc at all and the nodes of a version are contiguous in memory.
+
+API:
+
+types:
+
+  - slot_arena
+  a resettable monotonic arena: allocate() bumps a pointer, deallocate is a no-op,
+  reset() rewinds it and keeps the memory (merging it into a single block),
+  rewind( mark() ) rewinds it to a point and keeps what was allocated before it in place
+
+  - arena_allocator< T >
+  a stateful allocator pointing to a slot_arena, it never propagates on copy/move/swap
+  so the container keeps the arena of its slot
+
+  - arena_slot< container_type >
+  derives from container_type (which must use arena_allocator) and owns the arena,
+  so a functor accepting container_type* works as is
+
+  - arena_map< key_type, value_type, compare = std::less< key_type > >
+  an arena_slot of a std::map
+
+usage:
+
+  atomic_data< arena_map< int, int > > map0;
+  map0.update( []( arena_map< int, int >::container_type* map1 ) { ... } );
+
+  an arena_slot must not be moved around in memory (the allocator points to its arena),
+  which is always the case for atomic_data.
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <map>
+#include <utility>
+#include <functional>
+#include <type_traits>
+
+
+struct slot_arena {
+
+  using size_t = std::size_t;
+
+  static const size_t block_size = 4096;
+
+  slot_arena() { }
+  slot_arena( slot_arena const& ) = delete;
+  slot_arena& operator=( slot_arena const& ) = delete;
+
+  ~slot_arena() {
+    release( first );
+  }
+
+  void* allocate( size_t size, size_t align ) {
+
+    while( true ) {
+
+      if( current ) {
+        size_t pos = ( position + align - 1 ) & ~( align - 1 );
+        if( pos + size <= current->size ) {
+          position = pos + size;
+          used += size;
+          return current->data() + pos;
+        }
+      }
+
+      //move to the next retained block or grab a new one
+      if( current && current->next ) {
+        current = current->next;
+      } else {
+        size_t size_new = block_size;
+        while( size_new < size + align ) size_new *= 2;
+        if( current ) current->next = grab( size_new );
+        else first = grab( size_new );
+        current = current ? current->next : first;
+      }
+
+      position = 0;
+    }
+  }
+
+  //rewind the arena, the memory is kept for the next round of allocations
+  //if the last round needed several blocks they are merged into one
+  void reset() {
+
+    if( first && first->next ) {
+      size_t total = 0;
+      for( block* b = first; b; b = b->next ) total += b->size;
+      release( first );
+      first = grab( total );
+    }
+
+    current = first;
+    position = 0;
+    used = 0;
+  }
+
+  //bytes handed out since the last reset
+  size_t size() const { return used; }
+
+  struct block {
+    block* next;
+    size_t size;
+    char* data() { return (char*) ( this + 1 ); }
+  };
+
+  //a point in the arena
+  struct mark_t {
+    block* current;
+    size_t position;
+    size_t used;
+  };
+
+  mark_t mark() const { return { current, position, used }; }
+
+  //rewind to a mark: the allocations made before it stay where they are, the blocks are kept
+  //(a mark taken on an empty arena is a reset)
+  void rewind( mark_t mark0 ) {
+    if( ! mark0.current ) return reset();
+    current = mark0.current;
+    position = mark0.position;
+    used = mark0.used;
+  }
+
+private:
+
+  static_assert( sizeof( block ) % alignof( std::max_align_t ) == 0, "block header must keep data aligned" );
+
+  static block* grab( size_t size ) {
+    block* b = (block*) std::malloc( sizeof( block ) + size );
+    if( ! b ) throw std::bad_alloc{ };
+    b->next = nullptr;
+    b->size = size;
+    return b;
+  }
+
+  static void release( block* b ) {
+    while( b ) {
+      block* next = b->next;
+      std::free( b );
+      b = next;
+    }
+  }
+
+  block* first = nullptr;
+  block* current = nullptr;
+  size_t position = 0;
+  size_t used = 0;
+};
+
+
+template< typename T0 >
+struct arena_allocator {
+
+  using value_type = T0;
+
+  //the allocator stays with the container it was given to
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::false_type;
+  using propagate_on_container_swap = std::false_type;
+
+  arena_allocator( slot_arena* arena_ ) noexcept : arena{ arena_ } { }
+
+  template< typename U0 >
+  arena_allocator( arena_allocator<U0> const& r ) noexcept : arena{ r.arena } { }
+
+  T0* allocate( std::size_t n ) {
+    return (T0*) arena->allocate( n * sizeof( T0 ), alignof( T0 ) );
+  }
+
+  //memory is given back on slot_arena::reset
+  void deallocate( T0*, std::size_t ) noexcept { }
+
+  slot_arena* arena;
+};
+
+template< typename T0, typename U0 >
+bool operator==( arena_allocator<T0> const& lhs, arena_allocator<U0> const& rhs ) { return lhs.arena == rhs.arena; }
+template< typename T0, typename U0 >
+bool operator!=( arena_allocator<T0> const& lhs, arena_allocator<U0> const& rhs ) { return lhs.arena != rhs.arena; }
+
+
+//the arena has to be constructed before the container that uses it, hence a base class
+struct arena_holder {
+  slot_arena arena;
+};
+
+template< typename T0 >
+struct arena_slot : arena_holder, T0 {
+
+  using container_type = T0;
+  using allocator_type = typename T0::allocator_type;
+
+  //an empty container might already own memory (some standard libraries allocate a sentinel node
+  //in the default constructor): start marks the end of it, updates rewind the arena only that far
+  arena_slot() : T0( allocator_type{ &arena } ) {
+    start = arena.mark();
+  }
+
+  arena_slot( arena_slot const& r ) : arena_holder{ }, T0( allocator_type{ &arena } ) {
+    start = arena.mark();
+    T0::operator=( r );
+  }
+
+  //called by atomic_data on every update
+  arena_slot& operator=( arena_slot const& r ) {
+
+    if( this == &r ) return *this;
+
+    //drop the old contents (deallocation is a no-op), rewind and copy into the same memory
+    T0::clear();
+
+    arena.rewind( start );
+
+    T0::operator=( r );
+
+    return *this;
+  }
+
+  //an arena_slot is bound to its memory location
+  arena_slot( arena_slot&& ) = delete;
+  arena_slot& operator=( arena_slot&& ) = delete;
+
+  slot_arena::mark_t start;
+};
+
+
+template< typename K0, typename V0, typename C0 = std::less<K0> >
+using arena_map = arena_slot< std::map< K0, V0, C0, arena_allocator< std::pair<const K0, V0> > > >;
+
@@ -0,0 +1,128 @@
+/*
+
+atomic_chunked_vector against atomic_data< std::vector > (the atomic_vector sample) for
+vectors from 1K to 10M elements.
+
+Updater threads increment random elements, reader threads read random elements.
+std::vector copies all the elements on every update, atomic_chunked_vector copies its
+spine of chunk references and the chunk that is written to.
+At the end we check that the sum of all elements equals the number of increments.
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "atomic_data.h"
+#include "atomic_data_std.h"
+#include "atomic_chunked_vector.h"
+
+namespace {
+
+  using uint = unsigned;
+
+  //edit to change the test setup
+  const uint iterations = 256;
+  const uint threads_size = 4;
+  const uint sizes[] = { 1000, 10000, 100000, 1000000, 10000000 };
+
+  using vector_t = std::vector<uint>;
+  using atomic_vector_t = atomic_data<vector_t, threads_size * 2>;
+  using atomic_chunked_vector_t = atomic_chunked_vector<uint, threads_size * 2>;
+
+  volatile uint global_dummy;
+
+  //element write access
+  uint& write( vector_t& vector0, uint index ) { return vector0[ index ]; }
+  uint& write( atomic_chunked_vector_t::spine& vector0, uint index ) { return vector0.write( index ); }
+
+}
+
+template< typename T, typename U > uint test_vector( T& vector0, uint size );
+
+int main() {
+
+  printf( "Test parameters:\n\tCPU: %d core(s)\n\tupdates/thread: %d\n\tthreads: %d\n\tchunk size: %d\n\n",
+    std::thread::hardware_concurrency(), iterations, threads_size, (uint) atomic_chunked_vector_t::chunk_size );
+
+  printf( "time in microseconds\n" );
+  printf( "%10s %14s %22s\n", "size", "atomic_vector", "atomic_chunked_vector" );
+
+  for( uint size : sizes ) {
+
+    atomic_vector_t atomic_vector{ new vector_t( size ) };
+
+    atomic_chunked_vector_t atomic_chunked_vector0;
+    atomic_chunked_vector0.update( [ size ]( atomic_chunked_vector_t::spine* vector0 ) {
+      vector0->resize( size );
+      return true;
+    } );
+
+    uint time_vector = test_vector<atomic_vector_t, vector_t>( atomic_vector, size );
+    uint time_chunked = test_vector<atomic_chunked_vector_t, atomic_chunked_vector_t::spine>( atomic_chunked_vector0, size );
+
+    printf( "%10u %14u %22u\n", size, time_vector, time_chunked );
+  }
+
+  printf( "\ndone\n" );
+}
+
+//test function
+//half of the threads increment random elements, the other half read, returns the time
+template< typename T, typename U >
+uint test_vector( T& vector0, uint size ) {
+
+  auto update = [ &vector0, size ]() {
+    auto seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    std::mt19937_64 gen0( seed );
+    std::uniform_int_distribution<uint> engine0{ 0, size - 1 };
+
+    for( uint i = 0; i < iterations; i++ ) {
+      uint index = engine0( gen0 );
+      vector0.update( [ index ]( U* vector1 ) {
+        //std::vector and spine share the syntax for reads, write() is the write barrier
+        write( *vector1, index )++;
+        return true;
+      } );
+    }
+  };
+
+  auto read = [ &vector0, size ]() {
+    auto seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    std::mt19937_64 gen0( seed );
+    std::uniform_int_distribution<uint> engine0{ 0, size - 1 };
+
+    for( uint i = 0; i < iterations; i++ ) {
+      uint index = engine0( gen0 );
+      global_dummy = vector0.read( [ index ]( U* vector1 ) { return (*vector1)[ index ]; } );
+      std::this_thread::yield();
+    }
+  };
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  std::thread threads[ threads_size ];
+  for( uint i = 0; i < threads_size; i++ ) threads[ i ] = i % 2 == 0 ? std::thread{ update } : std::thread{ read };
+  for( auto& thread : threads ) thread.join();
+
+  uint time = (uint) std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+
+  uint sum = vector0.read( []( U* vector1 ) {
+    uint sum = 0;
+    for( size_t i = 0; i < vector1->size(); i++ ) sum += (*vector1)[ i ];
+    return sum;
+  } );
+
+  uint total = iterations * ( threads_size / 2 );
+  if( sum != total ) printf( "failed! sum = %u, expected %u\n", sum, total );
+
+  return time;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+/*
+
+A vector using atomic_data that copies only what an update changes.
+
+atomic_data< std::vector > copies the whole vector on every update. atomic_chunked_vector
+keeps its elements in fixed size reference counted chunks (atomic_shared.h) listed in a
+small spine. An update copies the spine (chunk references, the ones that already match the
+queue element are skipped) and, through a write barrier, only the chunks it writes to.
+Unchanged chunks are shared between all versions in the atomic_data queue.
+
+API:
+
+create instance:
+
+  - atomic_chunked_vector< data_type, queue_size = 8, chunk_size = 4096 / sizeof( data_type ) >
+  queue_size is passed to atomic_data, chunk_size is the number of elements in a chunk
+
+types:
+
+  - spine
+  a version of the vector that is passed to the functors:
+
+    - data_type const& operator[]( size_t index ) const
+    read access
+
+    - data_type& write( size_t index )
+    the write barrier: makes the chunk of the element private to this version and returns the element
+
+    - void push_back( data_type value )
+    - void pop_back()
+    - void resize( size_t size )
+    - size_t size()
+
+methods:
+
+  - void update( F )
+  - bool update_weak ( F )
+  - auto read( F )
+  the same as for atomic_data, F accepts a spine*
+  in read the spine must not be modified
+
+  - size_t size()
+
+usage:
+
+  atomic_chunked_vector< int > vector0;
+  vector0.update( []( atomic_chunked_vector< int >::spine* vector1 ) { vector1->push_back( 1 ); return true; } );
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstddef>
+#include <vector>
+#include <type_traits>
+
+#include "atomic_data.h"
+#include "atomic_shared.h"
+
+
+template< typename T0, unsigned N0 = 8, std::size_t C0 = ( sizeof( T0 ) < 4096 ? 4096 / sizeof( T0 ) : 1 ) >
+struct atomic_chunked_vector {
+
+  using size_t = std::size_t;
+
+  static const size_t chunk_size = C0;
+
+  struct chunk : shared_base {
+    T0 data[ C0 ];
+  };
+
+  using chunk_ref = shared_ref<chunk>;
+
+  struct spine {
+
+    T0 const& operator[]( size_t index ) const {
+      return chunks[ index / C0 ]->data[ index % C0 ];
+    }
+
+    //Write Barrier
+    //a chunk referenced by other versions is copied before the first write
+    T0& write( size_t index ) {
+      chunk_ref& entry = chunks[ index / C0 ];
+      if( ! entry.unique() ) entry = chunk_ref{ new chunk( *entry ) };
+      return entry->data[ index % C0 ];
+    }
+
+    void push_back( T0 value ) {
+      if( length == chunks.size() * C0 ) chunks.emplace_back( new chunk{} );
+      write( length ) = (T0&&) value;
+      length++;
+    }
+
+    void pop_back() {
+      length--;
+      //a chunk that is left empty is dropped, the resources of the element are released if the
+      //chunk isn't shared (a shared one isn't copied just to clear a slot the other versions hold)
+      if( length % C0 == 0 ) chunks.pop_back();
+      else if( ! std::is_trivially_destructible<T0>::value && chunks.back().unique() ) chunks.back()->data[ length % C0 ] = T0{ };
+    }
+
+    void resize( size_t size ) {
+      while( length > size ) pop_back();
+      while( length < size ) push_back( T0{ } );
+    }
+
+    size_t size() const { return length; }
+
+    std::vector<chunk_ref> chunks;
+    size_t length = 0;
+  };
+
+
+  template< typename U0 >
+  auto read( U0 fn ) const -> decltype( fn( ( spine* ) nullptr ) ) {
+    return data.read( fn );
+  }
+
+  template< typename U0 >
+  auto update( U0 fn ) -> decltype( fn( ( spine* ) nullptr ), (void) 0 ) {
+    data.update( fn );
+  }
+
+  template< typename U0 >
+  bool update_weak( U0 fn ) {
+    return data.update_weak( fn );
+  }
+
+  size_t size() const {
+    return data.read( []( spine* spine0 ) { return spine0->size(); } );
+  }
+
+  atomic_data<spine, N0> data;
+};
+
@@ -0,0 +1,132 @@
+/*
+
+Copy cost of atomic_data updates for plain data of different sizes.
+
+Every update copies the current data into a queue element. Trivially copyable data types
+of ATOMIC_DATA_COPY_THRESHOLD bytes and bigger go through the large copy kernel (prefetch,
+AVX-512/AVX2 stores selected at runtime, non-temporal stores for the biggest ones).
+Here we time updates of structs from 64 bytes to 1 megabyte and compare:
+
+  - default: whatever atomic_data_copy picks for the size
+  - kernel: the large copy kernel for every size
+  - assign: plain copy assignment (compiler/libc memcpy)
+
+Threads increment words of the struct, at the end we check that no increments are lost.
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstdio>
+#include <chrono>
+
+#include "atomic_data.h"
+
+namespace {
+
+  using uint = unsigned;
+
+  //edit to change the test setup
+  //every size copies about bytes_total per thread
+  const uint threads_size = 4;
+  const uint bytes_total = 1 << 28;
+  const uint iterations_min = 64;
+
+  //test data structures
+  template< uint N0 > struct pod_default {
+    uint data[ N0 / sizeof( uint ) ];
+  };
+
+  template< uint N0 > struct pod_kernel {
+    uint data[ N0 / sizeof( uint ) ];
+  };
+
+  template< uint N0 > struct pod_assign {
+    uint data[ N0 / sizeof( uint ) ];
+  };
+
+  //the copy customization point for the two variants
+  template< uint N0 > void atomic_data_copy( pod_kernel<N0>& dst, pod_kernel<N0> const& src ) {
+    atomic_data_detail::copy_large( &dst, &src, sizeof( dst ) );
+  }
+
+  template< uint N0 > void atomic_data_copy( pod_assign<N0>& dst, pod_assign<N0> const& src ) {
+    dst = src;
+  }
+
+}
+
+template< typename T > uint test_atomic_copy( uint iterations );
+
+template< uint N0 > void test_size() {
+
+  uint iterations = bytes_total / N0 < iterations_min ? iterations_min : bytes_total / N0;
+
+  uint time_default = test_atomic_copy< pod_default<N0> >( iterations );
+  uint time_kernel = test_atomic_copy< pod_kernel<N0> >( iterations );
+  uint time_assign = test_atomic_copy< pod_assign<N0> >( iterations );
+
+  printf( "%8u %10u %10u %10u %10u\n", N0, iterations, time_default, time_kernel, time_assign );
+}
+
+int main() {
+
+  printf( "Test parameters:\n\tCPU: %d core(s)\n\tthreads: %d\n\tbytes copied/thread: %d\n\tcopy threshold: %d\n\tstream threshold: %d\n\n",
+    std::thread::hardware_concurrency(), threads_size, bytes_total, ATOMIC_DATA_COPY_THRESHOLD, ATOMIC_DATA_STREAM_THRESHOLD );
+
+  printf( "time in microseconds\n" );
+  printf( "%8s %10s %10s %10s %10s\n", "size", "updates", "default", "kernel", "assign" );
+
+  test_size< 64 >();
+  test_size< 256 >();
+  test_size< 1024 >();
+  test_size< 4096 >();
+  test_size< 16384 >();
+  test_size< 65536 >();
+  test_size< 262144 >();
+  test_size< 1048576 >();
+
+  printf( "\ndone\n" );
+}
+
+//test function
+//creates thread_size threads that increment words of the struct, returns the time
+template< typename T >
+uint test_atomic_copy( uint iterations ) {
+
+  //queue elements are preallocated on first use of the type
+  atomic_data<T, threads_size * 2> atomic_pod{ new T{} };
+
+  const uint words = sizeof( T ) / sizeof( uint );
+
+  auto fn = [ &atomic_pod, iterations, words ]( uint thread_id ) {
+    for( uint i = 0; i < iterations; i++ ) {
+      atomic_pod.update( [ = ]( T* pod ) {
+        pod->data[ ( i * threads_size + thread_id ) % words ]++;
+        return true;
+      } );
+    }
+  };
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  std::thread threads[ threads_size ];
+  for( uint i = 0; i < threads_size; i++ ) threads[ i ] = std::thread{ fn, i };
+  for( auto& thread : threads ) thread.join();
+
+  uint time = (uint) std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+
+  uint sum = atomic_pod.read( [ words ]( T* pod ) {
+    uint sum = 0;
+    for( uint i = 0; i < words; i++ ) sum += pod->data[ i ];
+    return sum;
+  } );
+
+  if( sum != iterations * threads_size ) printf( "failed! sum = %u, expected %u\n", sum, iterations * threads_size );
+
+  return time;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+/*
+
+A sharded counter for the sizes of the structures built on atomic_data.
+
+A single atomic counter updated by every insert and erase bounces its cache line between
+all writing threads. sharded_counter spreads the updates over shards padded to a cache line,
+a thread always adds to the same shard (assigned round-robin on its first use).
+Reading sums the shards: a constant number of relaxed loads. The sum is exact when there are
+no concurrent updates, otherwise it's a value the counter had recently (updates in flight
+might be missing), it's clamped at 0.
+
+API:
+
+types:
+
+  - sharded_counter< shards = 16 >
+
+methods:
+
+  - void add( long value )
+  - size_t load() const
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstddef>
+#include <atomic>
+
+
+template< unsigned S0 = 16 >
+struct sharded_counter {
+
+  using uint = unsigned;
+  using size_t = std::size_t;
+
+  static const size_t cache_line = 64;
+
+  //padded, so the counts of two shards are never in the same cache line
+  struct shard {
+    std::atomic<long> count{ 0 };
+    char pad[ cache_line - sizeof( std::atomic<long> ) ];
+  };
+
+  void add( long value ) {
+    shards[ index() ].count.fetch_add( value, std::memory_order_relaxed );
+  }
+
+  size_t load() const {
+    long sum = 0;
+    for( auto& shard0 : shards ) sum += shard0.count.load( std::memory_order_relaxed );
+    return sum > 0 ? (size_t) sum : 0;
+  }
+
+  static uint index() {
+    static std::atomic<uint> next{ 0 };
+    thread_local uint index0 = next.fetch_add( 1, std::memory_order_relaxed ) % S0;
+    return index0;
+  }
+
+  shard shards[ S0 ];
+};
+
@@ -0,0 +1,231 @@
+/*
+
+atomic_counter_map on the workload of atomic_map.cpp: threads use their id to increment their
+counters and read them, against atomic_data< std::map > and atomic_data_mutex< std::map >.
+The second column is the increments alone: all threads increment, no reads, no yields.
+
+Every updater increments its counter and checks that it reads its own writes. Meanwhile a thread
+takes snapshots: every updater increments two counters (first then second) per iteration, so in
+an exact snapshot the first one is equal to the second one or greater by one. At the end we check
+the counts.
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <map>
+
+#include "atomic_data.h"
+#include "atomic_data_std.h"
+#include "atomic_data_mutex.h"
+#include "atomic_counter_map.h"
+
+namespace {
+
+  using uint = unsigned;
+  using map = std::map<uint, uint>;
+
+  //edit to change the test setup
+  const uint cycles_update = 102400;
+  const uint cycles_read = 819200;
+  const uint threads_size = 8;
+  const uint snapshots_size = 1000;
+
+  using atomic_map_t = atomic_data<map, threads_size * 2>;
+  using atomic_map_mutex_t = atomic_data_mutex<map>;
+  using atomic_counter_map_t = atomic_counter_map<uint>;
+
+  volatile uint global_dummy;
+
+  //the same syntax for all map types
+  template< typename T > void increment( T& map0, uint key ) {
+    map0.update( [ key ]( map* map1 ) { (*map1)[ key ]++; return true; } );
+  }
+
+  void increment( atomic_counter_map_t& map0, uint key ) {
+    map0.add( key );
+  }
+
+  template< typename T > uint get( T& map0, uint key ) {
+    return map0.read( [ key ]( map* map1 ) {
+      auto i = map1->find( key );
+      return i == map1->end() ? 0 : i->second;
+    } );
+  }
+
+  uint get( atomic_counter_map_t& map0, uint key ) {
+    return (uint) map0.get( key );
+  }
+
+  uint elapsed( std::chrono::high_resolution_clock::time_point start ) {
+    return (uint) std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+  }
+
+}
+
+template< typename T > uint test_map( T& map0, bool& passed );
+template< typename T > uint test_increments( T& map0, bool& passed );
+
+int main() {
+
+  printf( "Test parameters:\n\tCPU: %d core(s)\n\tupdate iterations: %d\n\tread iterations: %d\n\tthreads: %d\n\n",
+    std::thread::hardware_concurrency(), cycles_update, cycles_read, threads_size );
+
+  bool passed = true;
+
+  printf( "time in milliseconds\n" );
+  printf( "%20s %10s %12s\n", "", "mixed", "increments" );
+
+  {
+    atomic_map_t atomic_map, atomic_map1;
+    uint time = test_map( atomic_map, passed );
+    uint time1 = test_increments( atomic_map1, passed );
+    printf( "%20s %10u %12u\n", "atomic_map", time, time1 );
+  }
+
+  {
+    atomic_map_mutex_t atomic_map_mutex, atomic_map_mutex1;
+    uint time = test_map( atomic_map_mutex, passed );
+    uint time1 = test_increments( atomic_map_mutex1, passed );
+    printf( "%20s %10u %12u\n", "atomic_map_mutex", time, time1 );
+  }
+
+  {
+    atomic_counter_map_t atomic_counter_map0, atomic_counter_map1;
+    uint time = test_map( atomic_counter_map0, passed );
+    uint time1 = test_increments( atomic_counter_map1, passed );
+    printf( "%20s %10u %12u\n", "atomic_counter_map", time, time1 );
+  }
+
+  //snapshots while the counters change
+  {
+    atomic_counter_map_t atomic_counter_map0;
+    std::atomic<uint> running{ threads_size };
+
+    auto update = [ &atomic_counter_map0, &running ]( uint thread_id ) {
+      for( uint i = 0; i < cycles_update; i++ ) {
+        atomic_counter_map0.add( thread_id * 2 );
+        atomic_counter_map0.add( thread_id * 2 + 1 );
+      }
+      running.fetch_sub( 1 );
+    };
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::thread threads[ threads_size ];
+    for( uint i = 0; i < threads_size; i++ ) threads[ i ] = std::thread{ update, i };
+
+    uint snapshots = 0, inexact = 0;
+
+    while( snapshots < snapshots_size && running.load() > 0 ) {
+
+      auto snapshot = atomic_counter_map0.snapshot();
+
+      long counts[ threads_size * 2 ] = { };
+      for( auto& item : snapshot ) counts[ item.first ] = item.second;
+
+      for( uint i = 0; i < threads_size; i++ ) {
+        long diff = counts[ i * 2 ] - counts[ i * 2 + 1 ];
+        if( diff != 0 && diff != 1 ) inexact++;
+      }
+
+      snapshots++;
+      std::this_thread::yield();
+    }
+
+    for( auto& thread : threads ) thread.join();
+
+    uint time = elapsed( start );
+
+    bool passed0 = inexact == 0;
+    for( uint i = 0; i < threads_size * 2; i++ ) passed0 = passed0 && atomic_counter_map0.get( i ) == cycles_update;
+
+    printf( "\nsnapshots: %u during the updates, %u ms (%s)\n", snapshots, time, passed0 ? "Passed!" : "failed!" );
+
+    passed = passed && passed0;
+  }
+
+  printf( "\n%s\n", passed ? "Passed!" : "failed!" );
+
+  printf( "\ndone\n" );
+}
+
+//test function
+//half of the threads increment the counters of their ids and read them back, the other half read them,
+//returns the time
+template< typename T >
+uint test_map( T& map0, bool& passed ) {
+
+  std::atomic<uint> errors{ 0 };
+
+  auto update = [ &map0, &errors ]( uint thread_id ) {
+    for( uint i = 0; i < cycles_update; i++ ) {
+      increment( map0, thread_id );
+      //read-your-writes
+      if( get( map0, thread_id ) != i + 1 ) errors.fetch_add( 1 );
+      std::this_thread::yield();
+    }
+  };
+
+  auto read = [ &map0 ]( uint thread_id ) {
+    for( uint i = 0; i < cycles_read; i++ ) {
+      if( i % 100 == 0 ) std::this_thread::yield();
+      global_dummy = get( map0, thread_id );
+    }
+  };
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  std::thread threads[ threads_size ];
+  for( uint i = 0; i < threads_size; i += 2 ) {
+    threads[ i ] = std::thread{ update, i / 2 };
+    threads[ i + 1 ] = std::thread{ read, i / 2 };
+  }
+  for( auto& thread : threads ) thread.join();
+
+  uint time = elapsed( start );
+
+  for( uint i = 0; i < threads_size / 2; i++ ) if( get( map0, i ) != cycles_update ) errors.fetch_add( 1 );
+
+  if( errors.load() ) printf( "failed! %u errors\n", errors.load() );
+
+  passed = passed && errors.load() == 0;
+
+  return time;
+}
+
+//test function
+//all threads increment the counters of their ids, returns the time
+template< typename T >
+uint test_increments( T& map0, bool& passed ) {
+
+  auto update = [ &map0 ]( uint thread_id ) {
+    for( uint i = 0; i < cycles_update; i++ ) increment( map0, thread_id );
+  };
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  std::thread threads[ threads_size ];
+  for( uint i = 0; i < threads_size; i++ ) threads[ i ] = std::thread{ update, i };
+  for( auto& thread : threads ) thread.join();
+
+  uint time = elapsed( start );
+
+  uint errors = 0;
+  for( uint i = 0; i < threads_size; i++ ) if( get( map0, i ) != cycles_update ) errors++;
+
+  if( errors ) printf( "failed! %u errors\n", errors );
+
+  passed = passed && errors == 0;
+
+  return time;
+}
+
@@ -0,0 +1,371 @@
+#pragma once
+
+/*
+
+A map of counters for the increment pattern of atomic_map.cpp.
+
+atomic_data< std::map > copies the whole map for every ++ of a value. atomic_counter_map gives every
+key a slot number and keeps the counts in shards, one per thread: a thread claims a shard on its
+first add and is its only writer, so an add is a load and a store to memory of that thread, no CAS.
+A thread keeps a cache of the slots of the keys it added to, so the hot path doesn't touch any
+shared memory. Reading a count sums the slot over the shards.
+
+The keys live in a copy-on-write index (atomic_data< std::unordered_map< key, slot > >) that is
+updated only when a key is added for the first time, so the map suits a key set that settles while
+the counts keep changing. Keys are never removed.
+
+Threads beyond the number of shards share one more shard, locked for the duration of an add. When a
+thread exits its shard (with the counts) is free for the next thread.
+
+The counts of a shard are in pages of 1024 counts allocated on the first add to one of their keys,
+the table of the pages grows with the keys (doubles, the old tables are freed with the shard). An
+empty map is the index and the shards without pages, a shard a thread has added to costs a page
+(8 KB) per 1024 keys and the table of pointers to them.
+
+A read of a count is a sum of relaxed loads, a thread always sees its own adds (read-your-writes),
+but a read of several counts isn't a snapshot. snapshot() returns an exact one: every shard has a
+sequence number that is odd during an add, the snapshot reads the sequence numbers, the counts and
+the sequence numbers again and retries if any of them changed. After a few retries it pauses the
+adds (new adds wait, the ones in flight finish) so it can't be starved.
+
+API:
+
+create instance:
+
+  - atomic_counter_map< key_type, hash = std::hash< key_type >, shards = 64, queue_size = 8 >
+  queue_size is passed to atomic_data (the index)
+
+methods:
+
+  - void add( key_type const& key, long value = 1 )
+  adds the key if there is no such key, throws std::length_error if the map already has max_keys
+  keys (2M: page_size * pages_size)
+
+  - long get( key_type const& key ) const
+  0 if there is no such key
+
+  - void for_each( F ) const
+  F accepts a key and a count, the counts are read one by one like with get
+
+  - std::vector< std::pair< key_type, long > > snapshot() const
+  the keys and the counts at a single point in time
+
+  - size_t size() const
+  number of keys
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstddef>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <unordered_map>
+#include <stdexcept>
+
+#include "atomic_data.h"
+#include "atomic_data_std.h"
+#include "atomic_shared.h"
+
+
+template< typename K0, typename H0 = std::hash<K0>, unsigned S0 = 64, unsigned N0 = 8 >
+struct atomic_counter_map {
+
+  using uint = unsigned;
+  using size_t = std::size_t;
+
+  //counts are in pages allocated on demand, up to max_keys keys (pages_size is the biggest table)
+  static const size_t page_size = 1024;
+  static const size_t pages_size = 2048;
+  static const size_t max_keys = page_size * pages_size;
+
+  //snapshot attempts before the adds are paused
+  static const uint snapshot_tries = 8;
+
+  using index = std::unordered_map<K0, size_t, H0>;
+
+  //the pointers to the pages of a shard, replaced by a bigger copy when a key is past the end
+  //readers might still use an old one, so they are kept until the shard is gone
+  struct page_table {
+
+    page_table( size_t size_, page_table* prev_ ) : size{ size_ }, pages{ new std::atomic<std::atomic<long>*>[ size_ ]( ) }, prev{ prev_ } { }
+    ~page_table() { delete[] pages; }
+
+    size_t size;
+    std::atomic<std::atomic<long>*>* pages;
+    page_table* prev;
+  };
+
+  struct shard : shared_base {
+
+    ~shard() {
+      page_table* table0 = table.load( std::memory_order_relaxed );
+      if( table0 ) for( size_t i = 0; i < table0->size; i++ ) delete[] table0->pages[ i ].load( std::memory_order_relaxed );
+      while( table0 ) {
+        page_table* prev = table0->prev;
+        delete table0;
+        table0 = prev;
+      }
+    }
+
+    long get( size_t slot ) const {
+      page_table* table0 = table.load( std::memory_order_acquire );
+      if( ! table0 || slot / page_size >= table0->size ) return 0;
+      std::atomic<long>* page = table0->pages[ slot / page_size ].load( std::memory_order_acquire );
+      return page ? page[ slot % page_size ].load( std::memory_order_relaxed ) : 0;
+    }
+
+    //only the writer (the owner or the holder of the shared shard)
+    void add( size_t slot, long value ) {
+
+      page_table* table0 = table.load( std::memory_order_relaxed );
+
+      if( ! table0 || slot / page_size >= table0->size ) table0 = grow( table0, slot / page_size );
+
+      std::atomic<long>* page = table0->pages[ slot / page_size ].load( std::memory_order_relaxed );
+
+      if( ! page ) {
+        page = new std::atomic<long>[ page_size ]( );
+        table0->pages[ slot / page_size ].store( page, std::memory_order_release );
+      }
+
+      auto& count = page[ slot % page_size ];
+
+      uint seq0 = seq.load( std::memory_order_relaxed );
+      seq.store( seq0 + 1, std::memory_order_relaxed );
+      std::atomic_thread_fence( std::memory_order_release );
+      count.store( count.load( std::memory_order_relaxed ) + value, std::memory_order_relaxed );
+      seq.store( seq0 + 2, std::memory_order_release );
+    }
+
+    //a table with room for the page, the pages of the old one are copied, only the writer
+    page_table* grow( page_table* table0, size_t page ) {
+      size_t size = table0 ? table0->size : 1;
+      while( size <= page ) size *= 2;
+      page_table* table_new = new page_table{ size < pages_size ? size : pages_size, table0 };
+      if( table0 ) {
+        for( size_t i = 0; i < table0->size; i++ ) table_new->pages[ i ].store( table0->pages[ i ].load( std::memory_order_relaxed ), std::memory_order_relaxed );
+      }
+      table.store( table_new, std::memory_order_release );
+      return table_new;
+    }
+
+    //held by the owner thread for its lifetime, by the writer for an add for the shared shard
+    std::atomic<bool> owned{ false };
+
+    //odd during an add
+    std::atomic<uint> seq{ 0 };
+
+    std::atomic<page_table*> table{ nullptr };
+
+    //the slots of the keys added through this shard, only the writer
+    std::unordered_map<K0, size_t, H0> slots;
+  };
+
+  using shard_ptr = shared_ref<shard>;
+
+  //a shard of a thread in a map
+  struct local {
+    size_t id;
+    shard_ptr shard0;
+    bool owner;
+  };
+
+  //releases the shards when the thread exits
+  struct locals {
+    ~locals() {
+      for( auto& local0 : items ) if( local0.owner ) local0.shard0->owned.store( false, std::memory_order_release );
+    }
+    std::vector<local> items;
+  };
+
+  atomic_counter_map() : id{ next_id() } {
+    for( auto& shard0 : shards ) shard0.reset( new shard{ } );
+  }
+
+  atomic_counter_map( atomic_counter_map const& ) = delete;
+  atomic_counter_map& operator=( atomic_counter_map const& ) = delete;
+
+  void add( K0 const& key, long value = 1 ) {
+
+    local& local0 = local_shard();
+    shard* shard0 = local0.shard0.get();
+
+    //the shared shard is locked for the add (slot_of can throw)
+    struct unlock {
+      ~unlock() { if( shard0 ) shard0->owned.store( false, std::memory_order_release ); }
+      shard* shard0;
+    } unlock0{ nullptr };
+
+    if( ! local0.owner ) {
+      while( shard0->owned.exchange( true, std::memory_order_acquire ) ) std::this_thread::yield();
+      unlock0.shard0 = shard0;
+    }
+
+    size_t slot = slot_of( shard0, key );
+
+    while( paused.load( std::memory_order_relaxed ) ) std::this_thread::yield();
+
+    shard0->add( slot, value );
+  }
+
+  long get( K0 const& key ) const {
+    size_t slot;
+    bool found = keys.read( [ &key, &slot ]( index* index0 ) {
+      auto i = index0->find( key );
+      if( i == index0->end() ) return false;
+      slot = i->second;
+      return true;
+    } );
+    return found ? count( slot ) : 0;
+  }
+
+  template< typename U0 >
+  void for_each( U0 fn ) const {
+    keys.read( [ this, &fn ]( index* index0 ) {
+      for( auto& key : *index0 ) fn( (K0 const&) key.first, count( key.second ) );
+    } );
+  }
+
+  std::vector<std::pair<K0, long>> snapshot() const {
+
+    std::vector<std::pair<K0, long>> items;
+    uint seqs[ S0 + 1 ];
+
+    bool pausing = false;
+
+    for( uint i = 0; ; i++ ) {
+
+      if( i == snapshot_tries ) {
+        pausing = true;
+        paused.fetch_add( 1, std::memory_order_seq_cst );
+      }
+
+      bool changed = false;
+      for( uint s = 0; s < S0 + 1; s++ ) {
+        seqs[ s ] = shards[ s ]->seq.load( std::memory_order_acquire );
+        changed = changed || ( seqs[ s ] & 1 );
+      }
+
+      if( ! changed ) {
+
+        items.clear();
+
+        keys.read( [ this, &items ]( index* index0 ) {
+          for( auto& key : *index0 ) items.emplace_back( key.first, count( key.second ) );
+        } );
+
+        std::atomic_thread_fence( std::memory_order_acquire );
+
+        for( uint s = 0; s < S0 + 1; s++ ) changed = changed || shards[ s ]->seq.load( std::memory_order_relaxed ) != seqs[ s ];
+
+        if( ! changed ) break;
+      }
+
+      std::this_thread::yield();
+    }
+
+    if( pausing ) paused.fetch_sub( 1, std::memory_order_relaxed );
+
+    return items;
+  }
+
+  size_t size() const {
+    return keys.read( []( index* index0 ) { return index0->size(); } );
+  }
+
+  //shards are claimed in order, the ones past shards_used were never written
+  long count( size_t slot ) const {
+    long sum = shards[ S0 ]->get( slot );
+    for( uint s = 0, end = shards_used.load( std::memory_order_acquire ); s < end; s++ ) sum += shards[ s ]->get( slot );
+    return sum;
+  }
+
+  //the slot cache of the shard, then the index, then a new slot
+  size_t slot_of( shard* shard0, K0 const& key ) {
+
+    auto i = shard0->slots.find( key );
+    if( i != shard0->slots.end() ) return i->second;
+
+    size_t slot = 0;
+    bool found = false;
+
+    while( ! keys.update_weak( [ &key, &slot, &found ]( index* index0 ) {
+      auto i = index0->find( key );
+      found = i != index0->end();
+      if( found ) {
+        slot = i->second;
+        return false;
+      }
+      if( index0->size() == max_keys ) throw std::length_error{ "atomic_counter_map: too many keys" };
+      slot = index0->size();
+      index0->emplace( key, slot );
+      return true;
+    } ) && ! found );
+
+    shard0->slots.emplace( key, slot );
+
+    return slot;
+  }
+
+  //Shards of a Thread
+  //a thread claims a free shard on its first add to the map, the shared shard if there is none,
+  //the entries of the maps that are gone are dropped then (only the thread holds the shard)
+  local& local_shard() {
+
+    thread_local locals locals0;
+
+    auto& items = locals0.items;
+
+    for( auto& local0 : items ) if( local0.id == id ) return local0;
+
+    for( size_t i = 0; i < items.size(); ) {
+      if( items[ i ].shard0.unique() ) {
+        if( items[ i ].owner ) items[ i ].shard0->owned.store( false, std::memory_order_relaxed );
+        if( i + 1 != items.size() ) items[ i ] = (local&&) items.back();
+        items.pop_back();
+      } else i++;
+    }
+
+    for( uint s = 0; s < S0; s++ ) {
+      shard* shard0 = shards[ s ].get();
+      if( ! shard0->owned.load( std::memory_order_relaxed ) && ! shard0->owned.exchange( true, std::memory_order_acquire ) ) {
+        uint used = shards_used.load( std::memory_order_relaxed );
+        while( used < s + 1 && ! shards_used.compare_exchange_weak( used, s + 1, std::memory_order_release, std::memory_order_relaxed ) );
+        items.push_back( local{ id, shards[ s ], true } );
+        return items.back();
+      }
+    }
+
+    items.push_back( local{ id, shards[ S0 ], false } );
+    return items.back();
+  }
+
+  //ids instead of addresses: a new map can get the address of one that is gone
+  static size_t next_id() {
+    static std::atomic<size_t> ids{ 0 };
+    return ids.fetch_add( 1, std::memory_order_relaxed );
+  }
+
+  size_t id;
+
+  atomic_data<index, N0> keys;
+
+  //S0 shards of threads and the shared one
+  shard_ptr shards[ S0 + 1 ];
+
+  //the high-water mark of the claimed shards
+  std::atomic<uint> shards_used{ 0 };
+
+  mutable std::atomic<uint> paused{ 0 };
+
+};
+
+
@@ -0,0 +1,139 @@
+#pragma once
+/*
+
+atomic_data_std: atomic_data_copy for the standard containers (opt-in)
+
+The default copy of atomic_data is copy assignment, which for a container frees what the queue
+element owns and allocates it again. The copies here reuse the memory already owned by dst:
+
+  - std::vector and std::basic_string assign into the existing capacity and never propagate
+    the allocator, non-trivial vector elements are updated in place one by one
+  - std::map walks both maps in order, keeping the nodes of matching keys and updating their values
+  - std::unordered_map drops removed keys, updates the rest in place and adds new ones
+  maps with trivially copyable keys and values keep operator=, which already reuses nodes
+  in the common implementations
+
+Elements are copied with atomic_data_copy, so nested containers and user overloads work.
+
+usage:
+
+  include it before the first use of atomic_data with these containers (the copies are
+  specializations of atomic_data_copier, they are picked up when update_weak is instantiated)
+
+License: Public-domain Software.
+
+More is in the blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+*/
+
+#include <type_traits>
+#include <vector>
+#include <string>
+#include <map>
+#include <unordered_map>
+
+#include "atomic_data.h"
+
+
+namespace atomic_data_detail {
+
+  template< typename T0, typename A0 >
+  void copy( std::vector<T0, A0>& dst, std::vector<T0, A0> const& src, std::true_type ) {
+    dst.assign( src.begin(), src.end() );
+  }
+
+  //existing elements are updated in place, the tail is erased or appended
+  template< typename T0, typename A0 >
+  void copy( std::vector<T0, A0>& dst, std::vector<T0, A0> const& src, std::false_type ) {
+    if( dst.size() > src.size() ) dst.erase( dst.begin() + src.size(), dst.end() );
+    auto size = dst.size();
+    for( decltype( size ) i = 0; i < size; i++ ) atomic_data_copy( dst[ i ], src[ i ] );
+    dst.insert( dst.end(), src.begin() + size, src.end() );
+  }
+
+  //trivial nodes: let the implementation reuse nodes in operator=
+  template< typename M0 >
+  void copy_map( M0& dst, M0 const& src, std::true_type ) {
+    dst = src;
+  }
+
+  //walk both maps in order: keep matching nodes and update their values in place
+  template< typename M0 >
+  void copy_map( M0& dst, M0 const& src, std::false_type ) {
+    auto comp = dst.key_comp();
+    auto d = dst.begin();
+    auto s = src.begin();
+    while( s != src.end() ) {
+      if( d == dst.end() || comp( s->first, d->first ) ) {
+        dst.emplace_hint( d, *s );
+        ++s;
+      } else if( comp( d->first, s->first ) ) {
+        d = dst.erase( d );
+      } else {
+        atomic_data_copy( d->second, s->second );
+        ++d, ++s;
+      }
+    }
+    dst.erase( d, dst.end() );
+  }
+
+  template< typename M0 >
+  void copy_unordered_map( M0& dst, M0 const& src, std::true_type ) {
+    dst = src;
+  }
+
+  //drop the keys that are gone, update the values of the rest in place and add the new ones
+  template< typename M0 >
+  void copy_unordered_map( M0& dst, M0 const& src, std::false_type ) {
+    for( auto d = dst.begin(); d != dst.end(); ) {
+      if( src.find( d->first ) == src.end() ) d = dst.erase( d );
+      else ++d;
+    }
+    for( auto& s : src ) {
+      auto d = dst.find( s.first );
+      if( d != dst.end() ) atomic_data_copy( d->second, s.second );
+      else dst.emplace( s );
+    }
+  }
+
+  template< typename K0, typename V0 >
+  using is_trivial_pair = std::integral_constant< bool, std::is_trivially_copyable<K0>::value && std::is_trivially_copyable<V0>::value >;
+
+}
+
+//std::vector: reuses capacity, never propagates the allocator
+template< typename T0, typename A0 >
+struct atomic_data_copier< std::vector<T0, A0> > {
+  static void copy( std::vector<T0, A0>& dst, std::vector<T0, A0> const& src ) {
+    if( &dst == &src ) return;
+    atomic_data_detail::copy( dst, src, std::is_trivially_copyable<T0>{ } );
+  }
+};
+
+//std::basic_string: reuses capacity, never propagates the allocator
+template< typename C0, typename T0, typename A0 >
+struct atomic_data_copier< std::basic_string<C0, T0, A0> > {
+  static void copy( std::basic_string<C0, T0, A0>& dst, std::basic_string<C0, T0, A0> const& src ) {
+    if( &dst == &src ) return;
+    dst.assign( src.data(), src.size() );
+  }
+};
+
+//std::map: reuses the nodes of matching keys
+template< typename K0, typename V0, typename C0, typename A0 >
+struct atomic_data_copier< std::map<K0, V0, C0, A0> > {
+  static void copy( std::map<K0, V0, C0, A0>& dst, std::map<K0, V0, C0, A0> const& src ) {
+    if( &dst == &src ) return;
+    atomic_data_detail::copy_map( dst, src, atomic_data_detail::is_trivial_pair<K0, V0>{ } );
+  }
+};
+
+//std::unordered_map: reuses the nodes of matching keys
+template< typename K0, typename V0, typename H0, typename E0, typename A0 >
+struct atomic_data_copier< std::unordered_map<K0, V0, H0, E0, A0> > {
+  static void copy( std::unordered_map<K0, V0, H0, E0, A0>& dst, std::unordered_map<K0, V0, H0, E0, A0> const& src ) {
+    if( &dst == &src ) return;
+    atomic_data_detail::copy_unordered_map( dst, src, atomic_data_detail::is_trivial_pair<K0, V0>{ } );
+  }
+};
+
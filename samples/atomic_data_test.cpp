@@ -20,6 +20,8 @@ Alexandr Poltavsky
 
 #include <cstdio>
 #include <chrono>
+#include <atomic>
+#include <thread>
 
 #include "atomic_data.h"
 #include "atomic_data_mutex.h"
@@ -50,6 +52,24 @@ namespace {
   //for testing exception safety
   bool flag_throw = false;
 
+  //the copy constructor of atomic_data copy constructs the data (not default construct and assign)
+  struct copy_test {
+    copy_test( uint value_ = 0 ) : value{ value_ } { }
+    copy_test( copy_test const& r ) : value{ r.value }, constructed{ true } { }
+    copy_test& operator=( copy_test const& r ) { value = r.value; constructed = false; return *this; }
+    uint value;
+    bool constructed = false;
+  };
+
+  //the reclamation test: a version is never changed after it's published, a reader that sees it
+  //change while it holds the counter has got an element that was reused by a writer
+  struct reclaim_test {
+    uint value;
+    uint check;
+  };
+
+  const uint reclaim_iterations = 200000;
+
 }
 
 
@@ -95,6 +115,7 @@ void read( array_test *array ) {
 }
 
 template< typename T > void test_atomic_data( T& array0 );
+bool test_reclaim();
 
 int main() {
 
@@ -106,12 +127,21 @@ int main() {
   auto atomic_array_move = (decltype(atomic_array)&&) atomic_array_copy;
   atomic_array_move = atomic_array;
 
+  atomic_data<copy_test> atomic_copy_test{ new copy_test{ 42 } };
+  auto atomic_copy_test1 = atomic_copy_test;
+  atomic_copy_test1 = atomic_copy_test;
+  bool copied = atomic_copy_test1.read( []( copy_test* copy0 ) { return copy0->value == 42 && copy0->constructed; } );
+
   //and an instance of atomic_data_mutex to compare perfomance
   atomic_data_mutex<array_test> atomic_array_mutex{ new array_test{} };
 
   printf( "Test parameters:\n\tCPU: %d core(s)\n\tarray size: %d\n\titerations: %d\n\tthreads: %d\n\tread iterations: %d\n\tIncrements/array cell: %d\n",
     std::thread::hardware_concurrency(), array_size, iterations, threads_size, read_iterations, iterations * threads_size / array_size );
 
+  printf( "\ncopy construction: %s\n", copied ? "Passed!" : "failed!" );
+
+  printf( "reclamation: %s\n", test_reclaim() ? "Passed!" : "failed!" );
+
   printf( "\nstart testing atomic_data\n" );
   test_atomic_data( atomic_array );
 
@@ -168,3 +198,50 @@ void test_atomic_data( T& array0 ) {
 
 }
 
+//test function
+//a queue of two elements puts the sync barrier on every other update: the writers keep moving right
+//to the other half while the readers take the counter, a reader checks that the version it holds
+//doesn't change under it
+bool test_reclaim() {
+
+  atomic_data<reclaim_test, 2> reclaim0{ new reclaim_test{} };
+
+  std::atomic<uint> errors{ 0 };
+
+  auto update = [ &reclaim0 ]() {
+    for( uint i = 0; i < reclaim_iterations; i++ ) {
+      reclaim0.update( []( reclaim_test* reclaim1 ) {
+        reclaim1->value++;
+        reclaim1->check = reclaim1->value;
+        return true;
+      } );
+    }
+  };
+
+  auto read = [ &reclaim0, &errors ]() {
+    for( uint i = 0; i < reclaim_iterations; i++ ) {
+      reclaim0.read( [ &errors ]( reclaim_test* reclaim1 ) {
+        volatile uint* value = &reclaim1->value;
+        volatile uint* check = &reclaim1->check;
+        uint value0 = *value;
+        for( uint j = 0; j < 16; j++ ) {
+          //let the writers run while the version is held
+          if( j % 8 == 0 ) std::this_thread::yield();
+          if( *value != value0 || *check != value0 ) {
+            errors.fetch_add( 1 );
+            break;
+          }
+        }
+      } );
+    }
+  };
+
+  std::thread threads[ threads_size ];
+  for( uint i = 0; i < threads_size; i++ ) threads[ i ] = i % 2 == 0 ? std::thread{ update } : std::thread{ read };
+  for( auto& thread : threads ) thread.join();
+
+  uint value = reclaim0.read( []( reclaim_test* reclaim1 ) { return reclaim1->value; } );
+
+  return errors.load() == 0 && value == reclaim_iterations * ( threads_size / 2 );
+}
+
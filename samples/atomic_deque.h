@@ -0,0 +1,182 @@
+#pragma once
+
+/*
+
+A work-stealing deque (Chase-Lev, with the memory orders of N. M. Le, A. Pop, A. Cohen, F. Z. Nardelli,
+"Correct and Efficient Work-Stealing for Weak Memory Models").
+
+The owner thread pushes and pops at the bottom, other threads steal from the top. The elements are
+in a circular array indexed by position & ( size - 1 ), top and bottom are ever increasing positions,
+padded to a cache line. Only the last element is contended: the owner and the thieves race for it
+with a CAS of top, everything else is a relaxed load or store and a fence.
+
+The array grows when it's full: the owner copies the live elements to an array of double the size
+at the same positions and publishes it. Thieves might still be reading the old one, so arrays are
+reference counted (atomic_shared.h) and published with atomic_data: a thief gets a reference with a
+read, the old array is freed with the last reference (the versions in the queue of atomic_data or
+the thieves). The owner keeps its own reference and never goes through atomic_data on push and pop.
+
+API:
+
+create instance:
+
+  - atomic_deque< data_type, queue_size = 8 >
+  data_type is trivially copyable (the elements are read by a thief before it knows it got them),
+  queue_size is passed to atomic_data (the array versions)
+
+methods:
+
+  - atomic_deque( size_t capacity = 64 )
+  the initial size of the array, rounded up to a power of two (at least 2)
+
+owner:
+
+  - void push( data_type value )
+  - bool pop( data_type& value )
+  LIFO at the bottom, pop fails if the deque is empty
+
+any thread:
+
+  - bool steal( data_type& value )
+  FIFO at the top, fails if the deque is empty or another thread got the element
+
+  - size_t size(), bool empty()
+  approximate while there are updates in flight
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstddef>
+#include <atomic>
+#include <type_traits>
+
+#include "atomic_data.h"
+#include "atomic_shared.h"
+
+
+template< typename T0, unsigned N0 = 8 >
+struct atomic_deque {
+
+  static_assert( std::is_trivially_copyable<T0>::value, "data_type of the atomic_deque must be trivially copyable" );
+
+  using size_t = std::size_t;
+
+  static const size_t cache_line = 64;
+
+  struct array : shared_base {
+
+    array( size_t size_ ) : size{ size_ }, items{ new std::atomic<T0>[ size_ ] } { }
+    ~array() { delete[] items; }
+
+    T0 get( long pos ) const { return items[ (size_t) pos & ( size - 1 ) ].load( std::memory_order_relaxed ); }
+    void put( long pos, T0 value ) { items[ (size_t) pos & ( size - 1 ) ].store( value, std::memory_order_relaxed ); }
+
+    size_t size;
+    std::atomic<T0>* items;
+  };
+
+  using array_ptr = shared_ref<array>;
+
+  //data_type of atomic_data
+  struct buffer {
+    array_ptr items;
+  };
+
+  //padded, so the owner and the thieves don't share the lines of the positions
+  struct end {
+    std::atomic<long> pos{ 0 };
+    char pad[ cache_line - sizeof( std::atomic<long> ) ];
+  };
+
+  atomic_deque( size_t capacity = 64 ) : items{ new array{ round_up( capacity ) } }, current{ new buffer{ items } } { }
+
+  atomic_deque( atomic_deque const& ) = delete;
+  atomic_deque& operator=( atomic_deque const& ) = delete;
+
+  //the positions are masked with size - 1: the capacity is a power of two, at least 2
+  static size_t round_up( size_t capacity ) {
+    size_t size = 2;
+    while( size < capacity ) size *= 2;
+    return size;
+  }
+
+  void push( T0 value ) {
+    long bottom0 = bottom.pos.load( std::memory_order_relaxed );
+    long top0 = top.pos.load( std::memory_order_acquire );
+    if( bottom0 - top0 > (long) items->size - 1 ) grow( top0, bottom0 );
+    items->put( bottom0, value );
+    std::atomic_thread_fence( std::memory_order_release );
+    bottom.pos.store( bottom0 + 1, std::memory_order_relaxed );
+  }
+
+  //the last element goes to the owner or to a thief, whoever moves top first
+  bool pop( T0& value ) {
+
+    long bottom0 = bottom.pos.load( std::memory_order_relaxed ) - 1;
+    bottom.pos.store( bottom0, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    long top0 = top.pos.load( std::memory_order_relaxed );
+
+    if( top0 > bottom0 ) {
+      bottom.pos.store( bottom0 + 1, std::memory_order_relaxed );
+      return false;
+    }
+
+    value = items->get( bottom0 );
+
+    if( top0 < bottom0 ) return true;
+
+    bool r = top.pos.compare_exchange_strong( top0, top0 + 1, std::memory_order_seq_cst, std::memory_order_relaxed );
+    bottom.pos.store( bottom0 + 1, std::memory_order_relaxed );
+    return r;
+  }
+
+  bool steal( T0& value ) {
+
+    long top0 = top.pos.load( std::memory_order_acquire );
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    long bottom0 = bottom.pos.load( std::memory_order_acquire );
+
+    if( top0 >= bottom0 ) return false;
+
+    //an array grown meanwhile has the element at the same position, an old one keeps it
+    array_ptr items0 = current.read( []( buffer* buffer0 ) { return buffer0->items; } );
+    value = items0->get( top0 );
+
+    return top.pos.compare_exchange_strong( top0, top0 + 1, std::memory_order_seq_cst, std::memory_order_relaxed );
+  }
+
+  size_t size() const {
+    long size0 = bottom.pos.load( std::memory_order_relaxed ) - top.pos.load( std::memory_order_relaxed );
+    return size0 > 0 ? (size_t) size0 : 0;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  //only the owner writes the array, so the copy and the update can't conflict
+  void grow( long top0, long bottom0 ) {
+    array_ptr items_new{ new array{ items->size * 2 } };
+    for( long i = top0; i < bottom0; i++ ) items_new->put( i, items->get( i ) );
+    current.update( [ &items_new ]( buffer* buffer0 ) {
+      buffer0->items = items_new;
+      return true;
+    } );
+    items = (array_ptr&&) items_new;
+  }
+
+  end top;
+  end bottom;
+
+  //the reference of the owner
+  array_ptr items;
+
+  atomic_data<buffer, N0> current;
+
+};
+
+
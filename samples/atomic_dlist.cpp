@@ -0,0 +1,162 @@
+/*
+
+atomic_dlist: erase by an iterator against atomic_list, which has to find the node before it.
+
+The lists are filled with list_size elements, then erase_size nodes at random positions are
+erased through iterators kept from the fill (atomic_dlist::erase) and through positions
+(atomic_list::advance to the node before and erase_after_weak). Then the list is walked backwards.
+
+Then threads use the list as an LRU: every thread keeps iterators to its own nodes and moves a
+random one to the front (erase and push_front), or evicts from the back and appends a new node.
+At the end the size must be the same and the backward walk must match the forward one.
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "atomic_list.h"
+#include "atomic_dlist.h"
+
+namespace {
+
+  using uint = unsigned;
+
+  //edit to change the test setup
+  const uint list_size = 100000;
+  const uint erase_size = 1000;
+  const uint threads_size = 8;
+  const uint lru_size = 256;
+  const uint iterations = 16384;
+
+  using atomic_list_t = atomic_list<uint, threads_size * 2>;
+  using atomic_dlist_t = atomic_dlist<uint, threads_size * 2>;
+
+  uint elapsed( std::chrono::high_resolution_clock::time_point start ) {
+    return (uint) std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+  }
+
+}
+
+int main() {
+
+  printf( "Test parameters:\n\tCPU: %d core(s)\n\tlist size: %d\n\terasures: %d\n\tthreads: %d\n\tLRU size/thread: %d\n\titerations/thread: %d\n\n",
+    std::thread::hardware_concurrency(), list_size, erase_size, threads_size, lru_size, iterations );
+
+  std::mt19937_64 gen0( std::chrono::high_resolution_clock::now().time_since_epoch().count() );
+
+  //the same random positions for both lists
+  std::vector<uint> positions( list_size );
+  for( uint i = 0; i < list_size; i++ ) positions[ i ] = i;
+  std::shuffle( positions.begin(), positions.end(), gen0 );
+  positions.resize( erase_size );
+
+  //atomic_list: the position of a node shifts with the erasures before it
+  atomic_list_t list0;
+  for( uint i = list_size; i-- > 0; ) list0.push_front( i );
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  for( uint i = 0; i < erase_size; i++ ) {
+    uint index = positions[ i ];
+    for( uint j = 0; j < i; j++ ) if( positions[ j ] < positions[ i ] ) index--;
+    if( index == 0 ) list0.pop_front();
+    else {
+      auto it = list0.advance( index - 1 );
+      list0.erase_after_weak( it );
+    }
+  }
+
+  uint time_list = elapsed( start );
+
+  //atomic_dlist: the iterators are kept
+  atomic_dlist_t dlist0;
+  std::vector<atomic_dlist_t::iterator> its( list_size );
+  for( uint i = 0; i < list_size; i++ ) its[ i ] = dlist0.push_back( i );
+
+  start = std::chrono::high_resolution_clock::now();
+
+  bool passed = true;
+  for( uint i = 0; i < erase_size; i++ ) passed = dlist0.erase( its[ positions[ i ] ] ) && passed;
+
+  uint time_dlist = elapsed( start );
+
+  std::vector<uint> values0, values1;
+  list0.snapshot_to( values0 );
+  dlist0.for_each( [ &values1 ]( uint value ) { values1.push_back( value ); } );
+  passed = passed && values0 == values1 && dlist0.size() == list_size - erase_size;
+
+  printf( "erase of %u nodes at random positions, us:\n", erase_size );
+  printf( "\tatomic_list (advance + erase_after_weak): %u\n\tatomic_dlist (erase by iterator): %u\n", time_list, time_dlist );
+  printf( "erase: %s\n\n", passed ? "Passed!" : "failed!" );
+
+  //backward walk
+  start = std::chrono::high_resolution_clock::now();
+
+  uint count = 0;
+  passed = true;
+  for( auto it = dlist0.rbegin(); it; --it, count++ ) passed = passed && *it == values1[ values1.size() - 1 - count ];
+
+  printf( "backward walk of %u nodes: %u us (%s)\n\n", count, elapsed( start ), passed && count == values1.size() ? "ok" : "failed" );
+
+  its.clear();
+  dlist0.clear();
+
+  //LRU: move to front and evict from the back
+  std::atomic<long> added{ 0 };
+
+  auto run = [ &dlist0, &added ]( uint thread ) {
+
+    std::mt19937_64 gen1( std::chrono::high_resolution_clock::now().time_since_epoch().count() + thread );
+    std::uniform_int_distribution<uint> engine0{ 0, lru_size - 1 };
+
+    std::vector<atomic_dlist_t::iterator> own( lru_size );
+    for( uint i = 0; i < lru_size; i++ ) own[ i ] = dlist0.push_front( thread * lru_size + i );
+
+    long added0 = lru_size;
+
+    for( uint i = 0; i < iterations; i++ ) {
+      uint index = engine0( gen1 );
+      if( i % 8 == 0 ) {
+        if( dlist0.pop_back() ) added0--;
+        dlist0.push_back( i );
+        added0++;
+      } else if( dlist0.erase( own[ index ] ) ) {
+        own[ index ] = dlist0.push_front( *own[ index ] );
+      }
+    }
+
+    added.fetch_add( added0 );
+  };
+
+  start = std::chrono::high_resolution_clock::now();
+
+  std::thread threads[ threads_size ];
+  for( uint i = 0; i < threads_size; i++ ) threads[ i ] = std::thread{ run, i };
+  for( auto& thread : threads ) thread.join();
+
+  uint time_lru = elapsed( start );
+
+  values0.clear();
+  values1.clear();
+  dlist0.for_each( [ &values0 ]( uint value ) { values0.push_back( value ); } );
+  for( auto it = dlist0.rbegin(); it; --it ) values1.push_back( *it );
+  std::reverse( values1.begin(), values1.end() );
+
+  passed = values0 == values1 && (long) values0.size() == added.load() && (long) dlist0.size() == added.load();
+
+  printf( "LRU, %u threads: %u us, size %u (%s)\n", threads_size, time_lru, (uint) values0.size(), passed ? "Passed!" : "failed!" );
+
+  printf( "\ndone\n" );
+}
+
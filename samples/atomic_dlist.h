@@ -0,0 +1,450 @@
+#pragma once
+
+/*
+
+A doubly linked list using atomic_data, a variant of atomic_list (atomic_list.h) with O(1) expected
+erase by an iterator and reverse iteration.
+
+The next links are the same as in atomic_list: owning links in the versions of the nodes, a node
+is erased by marking it (the locked and deleted flags in the low bits of its next link) and then
+the link from the previous node is replaced. The prev links are not a part of the versions: every
+node keeps a hint, a raw pointer to a node that was before it when the hint was stored (set on
+insertion and when the node before it is unlinked). Nothing is freed through a hint, so erasing is
+a few steps, each a single update or store:
+
+  1. mark the node (an update of the node, after that nothing is inserted or erased after it)
+  2. find the node before it: follow the hint and walk forward to the node, usually zero steps
+  3. replace the link of the previous node (an update of it) and store the hint of the next node
+
+The hint might point to a freed node: the memory of a node is only reused for a node of the same
+type (atomic_pool.h), so a hint is followed by taking a reference only if the count isn't zero yet
+and checking the node belongs to the list and is not deleted, a deleted node is passed by its own
+hint. If the walk forward from the hint doesn't meet the node, the walk starts from the head (O(n)).
+The last node is found the same way from a hint of the list.
+
+API:
+
+types:
+
+  - iterator
+  holds a reference to a node, ++ and -- (-- from the first node and ++ from the last one give
+  end(), -- from a deleted node gives the node that was before it)
+
+  accesing node data: auto data = *it;
+  check if a node is deleted: bool iterator::is_deleted();
+  updating node data: bool iterator::update_weak( value ) ); //fails for various reasons
+                      bool iterator::update( value ) ); //fails only if deleted
+
+create instance:
+
+  - atomic_dlist< data_type, queue_length = 8, domain = void >
+  like atomic_list: nodes come from a node pool, lists with different domain types don't share
+  the queue of atomic_data and the pool
+
+methods:
+
+  - iterator insert_after_weak( iterator it, value )
+  inserts a node after it and returns an iterator to it, fails on contention or if it is deleted
+
+  - iterator push_front( value )
+  - iterator push_back( value )
+  never fail, push_back appends after the last node (a node appended meanwhile makes it retry)
+
+  - bool erase( iterator it )
+  O(1) expected, returns true if the node was erased by this call (it stays valid and deleted)
+
+  - iterator pop_front()
+  - iterator pop_back()
+  return the erased node or end() if the list is empty
+
+  - iterator begin(), end()
+  - iterator rbegin()
+  the last node, use with --: for( auto it = list.rbegin(); it; --it )
+
+  - void for_each( F )
+  borrowed traversal under one guard (see atomic_list.h), F accepts data_type const&
+
+  - size_t size()
+  - size_t size_exact()
+  - bool empty()
+  - void clear()
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstddef>
+#include <atomic>
+
+#include "atomic_data.h"
+#include "atomic_shared.h"
+#include "atomic_pool.h"
+#include "atomic_counter.h"
+
+
+template< typename T0, unsigned N0 = 8, typename D0 = void > struct atomic_dlist {
+
+  static_assert( N0 > 1, "queue_size for the atomic_dlist must be greater than 1 because erase requires 2 allocations from the queue." );
+
+  struct node;
+  struct atomic_node;
+
+  using node_ptr = shared_ref<atomic_node>;
+  using next_link = tagged_ref<atomic_node>;
+  using guard = typename atomic_data<node, N0>::guard;
+  using size_t = unsigned;
+
+  //deleted nodes passed through their hints before the head is used
+  static const size_t hint_hops = 8;
+
+  struct node {
+    T0 data;
+    next_link next;
+
+    bool locked() const { return next.tag( 0 ); }
+    bool deleted() const { return next.tag( 1 ); }
+
+    void mark() {
+      next.set_tag( 0, true );
+      next.set_tag( 1, true );
+    }
+
+    static void* operator new( std::size_t ) { return atomic_pool<node>::allocate(); }
+    static void operator delete( void* object ) { atomic_pool<node>::deallocate( object ); }
+  };
+
+  //prev and owner are hints outside of the versions, the owner is cleared when the node is freed
+  struct atomic_node : shared_base, atomic_data<node, N0> {
+
+    atomic_node( atomic_dlist const* owner_, node* node0 = new node{ } ) : atomic_data<node, N0>{ node0 }, owner{ owner_ } { }
+
+    ~atomic_node() { owner.store( nullptr, std::memory_order_relaxed ); }
+
+    std::atomic<atomic_node*> prev{ nullptr };
+    std::atomic<atomic_dlist const*> owner;
+
+    static void* operator new( std::size_t ) { return atomic_pool<atomic_node>::allocate(); }
+    static void operator delete( void* object ) { atomic_pool<atomic_node>::deallocate( object ); }
+  };
+
+  struct iterator {
+
+    iterator operator++() {
+      value = value->read( []( node* node0 ){
+          return node0->next.ref();
+      });
+      return *this;
+    }
+
+    iterator operator--() {
+      value = list->before( value.get() );
+      return *this;
+    }
+
+    bool operator==( iterator const& other ) const { return value == other.value; }
+    bool operator!=( iterator const& other ) const { return !operator==( other ); }
+    operator bool() const { return (bool) value; }
+
+    T0 operator*() const {
+      return value->read( []( node* node0 ){
+          return node0->data;
+      });
+    }
+
+    template<typename U0>
+    bool update( U0 fn ) {
+      while( true ) {
+        if( is_deleted() ) return false;
+        if( update_weak( fn ) ) break;
+      }
+      return true;
+    }
+
+    template<typename U0>
+    bool update_weak( U0 fn ) {
+      return value->update_weak( [&fn]( node* node0 ){
+        if( node0->locked() ) return false;
+        return fn( & node0->data );
+      });
+    }
+
+    bool is_deleted() const {
+      return value && atomic_dlist::is_deleted( value.get() );
+    }
+
+    node_ptr value;
+    atomic_dlist const* list = nullptr;
+  };
+
+
+  //empty node is our head of the list
+  atomic_dlist() : list{ new atomic_node{ this } } { }
+
+  //the nodes are released one by one, a long chain of references would recurse
+  ~atomic_dlist() {
+    release( exchange( node_ptr{ } ) );
+  }
+
+  iterator insert_after_weak( iterator& pos, T0 value ) {
+    return insert_after_weak( pos.value, (T0&&) value, false );
+  }
+
+  iterator push_front( T0 value ) {
+    iterator it;
+    while( ! (it = insert_after_weak( list, value, false )) );
+    return it;
+  }
+
+  iterator push_back( T0 value ) {
+    iterator it;
+    while( ! (it = insert_after_weak( last_node(), value, true )) );
+    return it;
+  }
+
+  //at_end fails if pos got a next node
+  iterator insert_after_weak( node_ptr const& pos, T0 value, bool at_end ) {
+
+    node* node0 = new node{ (T0&&) value };
+    node_ptr node_new{ new atomic_node{ this, node0 } };
+    node_new->prev.store( pos.get(), std::memory_order_relaxed );
+
+    node_ptr after;
+
+    bool r = pos->update_weak( [ node0, &node_new, &after, at_end ]( node* node1 ) {
+      if( node1->locked() || ( at_end && node1->next ) ) return false;
+      after = node1->next.ref();
+      node0->next = after;
+      node1->next = node_new;
+      return true;
+    } );
+
+    if( ! r ) {
+      node0->next.reset();
+      return {};
+    }
+
+    if( after ) after->prev.store( node_new.get(), std::memory_order_release );
+    else tail.store( node_new.get(), std::memory_order_release );
+
+    counter.add( 1 );
+    return { node_new, this };
+  }
+
+  //the mark is set once, the node is unlinked by this call or by a walk that met the mark
+  bool erase( iterator& it ) {
+
+    atomic_node* node0 = it.value.get();
+    bool marked = false;
+
+    while( ! node0->update_weak( [ &marked ]( node* node1 ) {
+      marked = node1->locked();
+      if( marked ) return false;
+      node1->mark();
+      return true;
+    } ) && ! marked );
+
+    if( ! marked ) counter.add( -1 );
+
+    while( node_ptr prev = find_prev( node0 ) ) {
+      if( unlink( prev.get(), node0 ) ) break;
+    }
+
+    return ! marked;
+  }
+
+  //a node marked elsewhere is unlinked (erase helps) and the next one is tried
+  iterator pop_front() {
+    while( true ) {
+      iterator it = begin();
+      if( ! it || erase( it ) ) return it;
+    }
+  }
+
+  iterator pop_back() {
+    while( true ) {
+      iterator it = rbegin();
+      if( ! it || erase( it ) ) return it;
+    }
+  }
+
+  iterator begin() const {
+    return ++iterator{ list, this };
+  }
+
+  iterator end() const { return {}; }
+
+  iterator rbegin() const {
+    node_ptr last = last_node();
+    return { last == list ? node_ptr{ } : last, this };
+  }
+
+  template< typename U0 >
+  void for_each( U0 fn ) const {
+    guard guard0{ };
+    node* node0 = list->read( guard0, []( node* node1 ) { return node1; } );
+    for( atomic_node* it = node0->next.get(); it; it = node0->next.get() ) {
+      node0 = it->read( guard0, []( node* node1 ) { return node1; } );
+      if( ! node0->deleted() ) fn( (T0 const&) node0->data );
+    }
+  }
+
+  //Hints
+  //a live node of this list at the hint or before it, the head is the last resort
+  node_ptr live_from( atomic_node* hint ) const {
+    for( size_t i = 0; hint && i < hint_hops; i++ ) {
+      node_ptr node0 = node_ptr::try_share( hint );
+      if( ! node0 || node0->owner.load( std::memory_order_acquire ) != this ) break;
+      if( ! is_deleted( node0.get() ) ) return node0;
+      hint = node0->prev.load( std::memory_order_acquire );
+    }
+    return list;
+  }
+
+  //the node before node0 (not deleted when it was passed), empty if node0 is not linked
+  node_ptr find_prev( atomic_node* node0 ) const {
+    node_ptr from = live_from( node0->prev.load( std::memory_order_acquire ) );
+    while( true ) {
+      node_ptr prev;
+      walk( from.get(), [ node0, &prev ]( atomic_node* prev0, atomic_node* it ) {
+        if( it != node0 ) return true;
+        prev = node_ptr::share( prev0 );
+        return false;
+      } );
+      if( prev || from == list ) return prev;
+      from = list;
+    }
+  }
+
+  //the last node that is not deleted, the head if the list is empty
+  node_ptr last_node() const {
+    node_ptr from = live_from( tail.load( std::memory_order_acquire ) );
+    atomic_node* last = from.get();
+    guard guard0{ };
+    walk( guard0, from.get(), [ &last ]( atomic_node*, atomic_node* it, node* node0 ) {
+      if( ! node0->deleted() ) last = it;
+      return true;
+    } );
+    return last == from.get() ? from : node_ptr::share( last );
+  }
+
+  //the node before a node (a deleted one is not linked, its hints are used), end() for the first one
+  node_ptr before( atomic_node* node0 ) const {
+    node_ptr prev = find_prev( node0 );
+    if( ! prev ) prev = live_from( node0->prev.load( std::memory_order_acquire ) );
+    return prev == list ? node_ptr{ } : prev;
+  }
+
+  //a borrowed traversal from a live node (see atomic_list.h), the marked nodes on the way are unlinked
+  //(best effort under the guard), fn( prev, it ) is called for every node including the marked ones
+  template< typename U0 >
+  void walk( atomic_node* from, U0 fn ) const {
+    guard guard0{ };
+    walk( guard0, from, [ &fn ]( atomic_node* prev, atomic_node* it, node* ) { return fn( prev, it ); } );
+  }
+
+  template< typename U0 >
+  void walk( guard const& guard0, atomic_node* from, U0 fn ) const {
+    atomic_node* prev = from;
+    node* node0 = from->read( guard0, []( node* node1 ) { return node1; } );
+    for( atomic_node* it = node0->next.get(); it; it = node0->next.get() ) {
+      node0 = it->read( guard0, []( node* node1 ) { return node1; } );
+      if( ! fn( prev, it, node0 ) ) return;
+      if( node0->deleted() ) unlink( prev, it );
+      else prev = it;
+    }
+  }
+
+  //replaces the link from prev to a marked node with the link to the node after it and moves
+  //the hint of that node to prev
+  bool unlink( atomic_node* prev, atomic_node* node_marked ) const {
+
+    node_ptr node_after;
+
+    bool marked = node_marked->read( [ &node_after ]( node* node0 ) {
+      node_after = node0->next.ref();
+      return node0->locked();
+    } );
+
+    if( ! marked ) return false;
+
+    bool r = prev->update_weak( [ node_marked, &node_after ]( node* node0 ) {
+      if( node0->locked() || node0->next.get() != node_marked ) return false;
+      node0->next = node_after;
+      return true;
+    } );
+
+    if( r && node_after ) node_after->prev.store( prev, std::memory_order_release );
+
+    return r;
+  }
+
+  static bool is_deleted( atomic_node* node0 ) {
+    return node0->read( []( node* node1 ) {
+      return node1->deleted();
+    } );
+  }
+
+  //replaces the chain after the head, returns the old one
+  node_ptr exchange( node_ptr chain ) {
+    node_ptr chain_old;
+    list->update( [ &chain, &chain_old ]( node* node0 ) {
+      chain_old = node0->next.ref();
+      node0->next = chain;
+      return true;
+    } );
+    return chain_old;
+  }
+
+  //marks the nodes of a detached chain and drops their links, returns the number of unmarked ones
+  static size_t release( node_ptr it ) {
+    size_t count = 0;
+    while( it ) {
+      node_ptr next;
+      bool marked = false;
+      it->update( [ &next, &marked ]( node* node0 ) {
+        marked = node0->locked();
+        next = node0->next.ref();
+        node0->next.reset();
+        node0->mark();
+        return true;
+      } );
+      if( ! marked ) count++;
+      it = (node_ptr&&) next;
+    }
+    return count;
+  }
+
+  size_t size() const {
+    return (size_t) counter.load();
+  }
+
+  size_t size_exact() const {
+    size_t count = 0;
+    for_each( [ &count ]( T0 const& ) { count++; } );
+    return count;
+  }
+
+  void clear() {
+    counter.add( - (long) release( exchange( node_ptr{ } ) ) );
+  }
+
+  bool empty() const {
+    return ! list->read( []( node* node0 ) {
+      return (bool) node0->next;
+    });
+  }
+
+  node_ptr list;
+
+  //a hint to the last node
+  mutable std::atomic<atomic_node*> tail{ nullptr };
+
+  sharded_counter<> counter;
+
+};
+
+
@@ -0,0 +1,167 @@
+/*
+
+atomic_hash_map against the two variants of the atomic_map sample, atomic_data< std::map >
+and atomic_data_mutex< std::map >, for maps from 1K to 10M keys.
+
+The maps are filled with size keys, then updater threads increment the values of random keys
+and reader threads look up random keys. At the end we check that no increments are lost.
+
+atomic_data< std::map > copies the whole map on every update, it is skipped for the sizes
+above map_copy_limit (a queue of full copies of a 10M map doesn't fit in memory).
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <map>
+
+#include "atomic_data.h"
+#include "atomic_data_std.h"
+#include "atomic_data_mutex.h"
+#include "atomic_hash_map.h"
+
+namespace {
+
+  using uint = unsigned;
+
+  //edit to change the test setup
+  const uint iterations = 256;
+  const uint threads_size = 4;
+  const uint sizes[] = { 1000, 10000, 100000, 1000000, 10000000 };
+  const uint map_copy_limit = 1000000;
+
+  using map = std::map<uint, uint>;
+  using atomic_map_t = atomic_data<map, threads_size * 2>;
+  using atomic_map_mutex_t = atomic_data_mutex<map>;
+  using atomic_hash_map_t = atomic_hash_map<uint, uint, std::hash<uint>, threads_size * 2>;
+
+  volatile uint global_dummy;
+
+  //the same syntax for both map types
+  uint* find( map* map0, uint key ) {
+    auto i = map0->find( key );
+    return i == map0->end() ? nullptr : &i->second;
+  }
+
+  uint const* find( atomic_hash_map_t::version* map0, uint key ) {
+    return map0->find( key );
+  }
+
+  void increment( map* map0, uint key ) {
+    (*map0)[ key ]++;
+  }
+
+  void increment( atomic_hash_map_t::version* map0, uint key ) {
+    uint const* value = map0->find( key );
+    map0->insert_or_assign( key, value ? *value + 1 : 1 );
+  }
+
+  template< typename T > uint sum( T* map0 ) {
+    uint sum = 0;
+    map0->for_each( [ &sum ]( uint, uint value ) { sum += value; } );
+    return sum;
+  }
+
+  template<> uint sum( map* map0 ) {
+    uint sum = 0;
+    for( auto& i : *map0 ) sum += i.second;
+    return sum;
+  }
+
+}
+
+template< typename T, typename U > uint test_map( T& map0, uint size );
+
+int main() {
+
+  printf( "Test parameters:\n\tCPU: %d core(s)\n\tupdates/thread: %d\n\tthreads: %d\n\n",
+    std::thread::hardware_concurrency(), iterations, threads_size );
+
+  printf( "time in microseconds\n" );
+  printf( "%10s %12s %18s %17s\n", "size", "atomic_map", "atomic_map_mutex", "atomic_hash_map" );
+
+  for( uint size : sizes ) {
+
+    uint time_map = 0;
+
+    if( size <= map_copy_limit ) {
+      atomic_map_t atomic_map;
+      time_map = test_map<atomic_map_t, map>( atomic_map, size );
+    }
+
+    atomic_map_mutex_t atomic_map_mutex;
+    uint time_map_mutex = test_map<atomic_map_mutex_t, map>( atomic_map_mutex, size );
+
+    atomic_hash_map_t atomic_hash_map0;
+    uint time_hash_map = test_map<atomic_hash_map_t, atomic_hash_map_t::version>( atomic_hash_map0, size );
+
+    if( size <= map_copy_limit ) printf( "%10u %12u %18u %17u\n", size, time_map, time_map_mutex, time_hash_map );
+    else printf( "%10u %12s %18u %17u\n", size, "-", time_map_mutex, time_hash_map );
+  }
+
+  printf( "\ndone\n" );
+}
+
+//test function
+//fills the map, half of the threads increment values of random keys, the other half read, returns the time
+template< typename T, typename U >
+uint test_map( T& map0, uint size ) {
+
+  map0.update( [ size ]( U* map1 ) {
+    for( uint i = 0; i < size; i++ ) increment( map1, i * 2 );
+    return true;
+  } );
+
+  //cycle the queue: it still holds the versions of the previous run (atomic_data queues are per type)
+  for( uint i = 0; i < threads_size * 4; i++ ) map0.update( []( U* ) { return true; } );
+
+  auto update = [ &map0, size ]() {
+    auto seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    std::mt19937_64 gen0( seed );
+    std::uniform_int_distribution<uint> engine0{ 0, size - 1 };
+
+    for( uint i = 0; i < iterations; i++ ) {
+      uint key = engine0( gen0 ) * 2;
+      map0.update( [ key ]( U* map1 ) {
+        increment( map1, key );
+        return true;
+      } );
+    }
+  };
+
+  auto read = [ &map0, size ]() {
+    auto seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    std::mt19937_64 gen0( seed );
+    std::uniform_int_distribution<uint> engine0{ 0, size - 1 };
+
+    for( uint i = 0; i < iterations; i++ ) {
+      uint key = engine0( gen0 ) * 2;
+      global_dummy = map0.read( [ key ]( U* map1 ) {
+        auto value = find( map1, key );
+        return value ? *value : 0;
+      } );
+      std::this_thread::yield();
+    }
+  };
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  std::thread threads[ threads_size ];
+  for( uint i = 0; i < threads_size; i++ ) threads[ i ] = i % 2 == 0 ? std::thread{ update } : std::thread{ read };
+  for( auto& thread : threads ) thread.join();
+
+  uint time = (uint) std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+
+  uint total = size + iterations * ( threads_size / 2 );
+  uint sum0 = map0.read( []( U* map1 ) { return sum( map1 ); } );
+  if( sum0 != total ) printf( "failed! sum = %u, expected %u\n", sum0, total );
+
+  return time;
+}
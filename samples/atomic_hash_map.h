@@ -0,0 +1,357 @@
+#pragma once
+
+/*
+
+A persistent hash map (hash array mapped trie) using atomic_data.
+
+atomic_data< std::map > copies the whole map on every update. atomic_hash_map keeps its
+entries in a trie of reference counted nodes (atomic_shared.h) indexed by 5 bits of the key
+hash per level. Nodes are never modified after they are published: an update copies only the
+nodes on the path from the root to the changed entry, O(log32 n) of them, and shares the rest.
+Nodes created by the same update are modified in place, so bulk inserts don't copy paths.
+The root is published through atomic_data, so reads stay wait-free.
+
+Inner nodes store entries inline and point to subnodes through two 32 bit maps
+(the CHAMP layout), keys with equal hashes end up in collision nodes at the bottom.
+
+API:
+
+create instance:
+
+  - atomic_hash_map< key_type, value_type, hash = std::hash< key_type >, queue_size = 8 >
+  queue_size is passed to atomic_data
+
+types:
+
+  - version
+  an immutable snapshot of the map that is passed to the functors, copying it is cheap:
+
+    - value_type const* find( key_type const& key ) const
+    returns nullptr if there is no such key
+
+    - void insert_or_assign( key_type const& key, value_type value )
+    - bool erase( key_type const& key )
+    modify the version, only available in update
+
+    - size_t size() const
+    - void for_each( F ) const
+    F accepts a key and a value
+
+methods:
+
+  - void update( F )
+  - bool update_weak ( F )
+  - auto read( F )
+  the same as for atomic_data, F accepts a version*
+
+  - version snapshot() const
+  a copy of the current version that can be kept and iterated without blocking writers
+
+  - void insert_or_assign( key_type const& key, value_type value )
+  - bool erase( key_type const& key )
+  - bool find( key_type const& key, value_type& value ) const
+  - size_t size() const
+  shortcuts for single operations
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <functional>
+
+#include "atomic_data.h"
+#include "atomic_shared.h"
+
+
+template< typename K0, typename V0, typename H0 = std::hash<K0>, unsigned N0 = 8 >
+struct atomic_hash_map {
+
+  using size_t = std::size_t;
+  using bitmap = std::uint32_t;
+
+  static const unsigned bits = 5;
+  static const unsigned hash_bits = sizeof( size_t ) * 8;
+
+  struct item {
+    size_t hash;
+    K0 key;
+    V0 value;
+  };
+
+  struct node;
+  using node_ref = shared_ref<node>;
+
+  //datamap marks inline items, nodemap marks subnodes
+  //below hash_bits all items are stored in items with matching hashes (a collision node)
+  struct node : shared_base {
+    bitmap datamap = 0;
+    bitmap nodemap = 0;
+    std::vector<item> items;
+    std::vector<node_ref> nodes;
+  };
+
+  static unsigned popcount( bitmap map ) {
+    map = map - ( ( map >> 1 ) & 0x55555555 );
+    map = ( map & 0x33333333 ) + ( ( map >> 2 ) & 0x33333333 );
+    return ( ( ( map + ( map >> 4 ) ) & 0x0F0F0F0F ) * 0x01010101 ) >> 24;
+  }
+
+  static bitmap bit( size_t hash, unsigned shift ) {
+    return bitmap( 1 ) << ( ( hash >> shift ) & ( ( 1 << bits ) - 1 ) );
+  }
+
+  static unsigned index( bitmap map, bitmap bit0 ) {
+    return popcount( map & ( bit0 - 1 ) );
+  }
+
+
+  //Trie Operations
+  //a node is modified in place only if this version is its single owner (created by this update),
+  //nodes shared with other versions are copied first, so published nodes never change
+
+  static void make_unique( node_ref& node0 ) {
+    if( ! node0.unique() ) node0 = node_ref{ new node( *node0 ) };
+  }
+
+  static V0 const* find( node const* node0, size_t hash, K0 const& key ) {
+
+    for( unsigned shift = 0; node0; shift += bits ) {
+
+      if( shift >= hash_bits ) {
+        for( auto& item0 : node0->items )
+          if( item0.key == key ) return &item0.value;
+        return nullptr;
+      }
+
+      bitmap bit0 = bit( hash, shift );
+
+      if( node0->datamap & bit0 ) {
+        item const& item0 = node0->items[ index( node0->datamap, bit0 ) ];
+        return item0.hash == hash && item0.key == key ? &item0.value : nullptr;
+      }
+
+      if( ! ( node0->nodemap & bit0 ) ) return nullptr;
+
+      node0 = node0->nodes[ index( node0->nodemap, bit0 ) ].get();
+    }
+
+    return nullptr;
+  }
+
+  //a node holding two items that share the hash bits above shift
+  static node_ref merge( item item0, item item1, unsigned shift ) {
+
+    node_ref node_new{ new node };
+
+    if( shift >= hash_bits ) {
+      node_new->items.push_back( (item&&) item0 );
+      node_new->items.push_back( (item&&) item1 );
+      return node_new;
+    }
+
+    bitmap bit0 = bit( item0.hash, shift );
+    bitmap bit1 = bit( item1.hash, shift );
+
+    if( bit0 != bit1 ) {
+      node_new->datamap = bit0 | bit1;
+      if( bit0 > bit1 ) std::swap( item0, item1 );
+      node_new->items.push_back( (item&&) item0 );
+      node_new->items.push_back( (item&&) item1 );
+    } else {
+      node_new->nodemap = bit0;
+      node_new->nodes.push_back( merge( (item&&) item0, (item&&) item1, shift + bits ) );
+    }
+
+    return node_new;
+  }
+
+  //returns true if the key was added
+  static bool insert( node_ref& node0, item&& item_new, unsigned shift ) {
+
+    make_unique( node0 );
+
+    node* node1 = node0.get();
+
+    if( shift >= hash_bits ) {
+      for( auto& item0 : node1->items ) {
+        if( item0.key == item_new.key ) {
+          item0.value = (V0&&) item_new.value;
+          return false;
+        }
+      }
+      node1->items.push_back( (item&&) item_new );
+      return true;
+    }
+
+    bitmap bit0 = bit( item_new.hash, shift );
+
+    if( node1->datamap & bit0 ) {
+
+      unsigned i = index( node1->datamap, bit0 );
+      item& item0 = node1->items[ i ];
+
+      if( item0.hash == item_new.hash && item0.key == item_new.key ) {
+        item0.value = (V0&&) item_new.value;
+        return false;
+      }
+
+      //two different keys in the same slot: push them down into a subnode
+      node_ref node_sub = merge( (item&&) item0, (item&&) item_new, shift + bits );
+      node1->items.erase( node1->items.begin() + i );
+      node1->datamap &= ~bit0;
+      node1->nodemap |= bit0;
+      node1->nodes.insert( node1->nodes.begin() + index( node1->nodemap, bit0 ), (node_ref&&) node_sub );
+      return true;
+    }
+
+    if( node1->nodemap & bit0 ) {
+      return insert( node1->nodes[ index( node1->nodemap, bit0 ) ], (item&&) item_new, shift + bits );
+    }
+
+    node1->datamap |= bit0;
+    node1->items.insert( node1->items.begin() + index( node1->datamap, bit0 ), (item&&) item_new );
+    return true;
+  }
+
+  //the key must be present (checked with find), otherwise the path would be copied for nothing
+  static void erase( node_ref& node0, size_t hash, K0 const& key, unsigned shift ) {
+
+    make_unique( node0 );
+
+    node* node1 = node0.get();
+
+    if( shift >= hash_bits ) {
+      for( size_t i = 0; i < node1->items.size(); i++ ) {
+        if( node1->items[ i ].key == key ) {
+          node1->items.erase( node1->items.begin() + i );
+          return;
+        }
+      }
+      return;
+    }
+
+    bitmap bit0 = bit( hash, shift );
+
+    if( node1->datamap & bit0 ) {
+      node1->items.erase( node1->items.begin() + index( node1->datamap, bit0 ) );
+      node1->datamap &= ~bit0;
+      return;
+    }
+
+    unsigned i = index( node1->nodemap, bit0 );
+    node_ref& node_sub = node1->nodes[ i ];
+
+    erase( node_sub, hash, key, shift + bits );
+
+    //keep the trie canonical: a subnode with a single item is inlined
+    if( node_sub->nodes.empty() && node_sub->items.size() <= 1 ) {
+      node_ref node_old = (node_ref&&) node_sub;
+      node1->nodes.erase( node1->nodes.begin() + i );
+      node1->nodemap &= ~bit0;
+      if( node_old->items.size() == 1 ) {
+        node1->datamap |= bit0;
+        node1->items.insert( node1->items.begin() + index( node1->datamap, bit0 ), (item&&) node_old->items[ 0 ] );
+      }
+    }
+  }
+
+  template< typename U0 >
+  static void for_each( node const* node0, U0& fn ) {
+    for( auto& item0 : node0->items ) fn( item0.key, item0.value );
+    for( auto& node_sub : node0->nodes ) for_each( node_sub.get(), fn );
+  }
+
+
+  //A Version of the Map
+  struct version {
+
+    version() : root{ new node } { }
+
+    V0 const* find( K0 const& key ) const {
+      return atomic_hash_map::find( root.get(), H0{ }( key ), key );
+    }
+
+    void insert_or_assign( K0 const& key, V0 value ) {
+      if( atomic_hash_map::insert( root, item{ H0{ }( key ), key, (V0&&) value }, 0 ) ) length++;
+    }
+
+    bool erase( K0 const& key ) {
+      size_t hash = H0{ }( key );
+      if( ! atomic_hash_map::find( root.get(), hash, key ) ) return false;
+      atomic_hash_map::erase( root, hash, key, 0 );
+      length--;
+      return true;
+    }
+
+    template< typename U0 >
+    void for_each( U0 fn ) const {
+      atomic_hash_map::for_each( root.get(), fn );
+    }
+
+    size_t size() const { return length; }
+
+    node_ref root;
+    size_t length = 0;
+  };
+
+
+  template< typename U0 >
+  auto read( U0 fn ) const -> decltype( fn( ( version* ) nullptr ) ) {
+    return data.read( fn );
+  }
+
+  template< typename U0 >
+  auto update( U0 fn ) -> decltype( fn( ( version* ) nullptr ), (void) 0 ) {
+    data.update( fn );
+  }
+
+  template< typename U0 >
+  bool update_weak( U0 fn ) {
+    return data.update_weak( fn );
+  }
+
+  version snapshot() const {
+    return data.read( []( version* version0 ) { return *version0; } );
+  }
+
+  void insert_or_assign( K0 const& key, V0 value ) {
+    data.update( [ &key, &value ]( version* version0 ) {
+      version0->insert_or_assign( key, value );
+      return true;
+    } );
+  }
+
+  //a missing key doesn't publish a version
+  bool erase( K0 const& key ) {
+    bool r = false, missing = false;
+    while( ! data.update_weak( [ &key, &r, &missing ]( version* version0 ) {
+      r = version0->erase( key );
+      missing = ! r;
+      return r;
+    } ) && ! missing );
+    return r;
+  }
+
+  bool find( K0 const& key, V0& value ) const {
+    return data.read( [ &key, &value ]( version* version0 ) {
+      V0 const* value0 = version0->find( key );
+      if( value0 ) value = *value0;
+      return value0 != nullptr;
+    } );
+  }
+
+  size_t size() const {
+    return data.read( []( version* version0 ) { return version0->size(); } );
+  }
+
+  atomic_data<version, N0> data;
+};
+
@@ -20,6 +20,7 @@ Alexandr Poltavsky
 #include <thread>
 #include <random>
 #include <chrono>
+#include <vector>
 
 #include "atomic_list.h"
 
@@ -28,6 +29,11 @@ using uint = unsigned;
 const uint threads_size = 16;
 const uint iterations = 32768;
 const uint list_size = 13;
+const uint walk_list_size = 100000;
+const uint walk_repeats = 16;
+const uint size_calls = 1000000;
+const uint bulk_size = 1000000;
+const uint cursor_walks = 1000;
 
 template< typename T > void print_list( T& );
 
@@ -73,10 +79,8 @@ int main() {
       do {
         uint index = engine0( gen0 );
 
-        auto it = atomic_list0.begin();
-        auto it_next = it;
-
-        for( uint i = 0; i < index && it_next; it = it_next++, ++i );
+        //a borrowed walk under one guard, only the node at index gets a reference
+        auto it = atomic_list0.advance( index );
 
         auto r = atomic_list0.insert_after_weak( it, value );
 
@@ -106,10 +110,8 @@ int main() {
       do {
         uint index = engine0( gen0 );
 
-        auto it = atomic_list0.begin();
-        auto it_next = it;
-
-        for( uint i = 0; i < index && it_next; it = it_next++, ++i );
+        //a borrowed walk under one guard, only the node at index gets a reference
+        auto it = atomic_list0.advance( index );
 
         auto r = atomic_list0.erase_after_weak( it );
 
@@ -127,6 +129,8 @@ int main() {
 
   printf( "\nstarting %u threads\n\n", threads_size );
 
+  auto start = std::chrono::high_resolution_clock::now();
+
   std::thread threads[ threads_size ];
 
   for( uint i = 0; i < threads_size; i++ ) 
@@ -134,16 +138,213 @@ int main() {
 
   for( auto& thread : threads ) thread.join();
 
+  auto time = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+  printf( "time: %u ms\n\n", (uint) time );
+
 
   printf( "list after test:\n");
   print_list( atomic_list0 );
 
-  printf( "\ntest: %s!\n\n", list_size == atomic_list0.size() ? "Passed" : "Failed" );
+  bool passed = list_size == atomic_list0.size() && list_size == atomic_list0.size_exact();
+  printf( "\ntest: %s!\n\n", passed ? "Passed" : "Failed" );
 
   printf( "clear atomic_list " );
   atomic_list0.clear();
   printf( "= *%d* elements left\n", atomic_list0.size() );
 
+  //allocation cost: the nodes of atomic_list come from a pool
+  atomic_list_t atomic_list1;
+
+  start = std::chrono::high_resolution_clock::now();
+
+  for( uint r = 0; r < walk_repeats; r++ ) {
+    for( uint i = 0; i < walk_list_size; i++ ) atomic_list1.push_front( i );
+    if( r < walk_repeats - 1 ) atomic_list1.clear();
+  }
+
+  time = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+  printf( "\npush_front/clear of %u elements: %u us\n", walk_list_size, (uint) time / walk_repeats );
+
+  //memory: the node data (the flags are in the next link) and the atomic_data wrapper, both from the pool
+  printf( "bytes per element: %u (node data %u, atomic_data node %u, pool blocks)\n",
+    (uint) ( sizeof( atomic_pool<atomic_list_t::node>::block ) + sizeof( atomic_pool<atomic_list_t::atomic_node>::block ) ),
+    (uint) sizeof( atomic_list_t::node ), (uint) sizeof( atomic_list_t::atomic_node ) );
+
+  //size() reads the sharded counter
+  start = std::chrono::high_resolution_clock::now();
+
+  uint walk_sum = 0;
+  for( uint i = 0; i < size_calls; i++ ) walk_sum += atomic_list1.size() == walk_list_size;
+
+  time = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+  printf( "size() of a list of %u elements: %u ns (%s)\n", walk_list_size, (uint) ( time / size_calls ),
+    walk_sum == size_calls ? "ok" : "failed" );
+
+  //traversal cost: size_exact() walks the list
+  start = std::chrono::high_resolution_clock::now();
+
+  walk_sum = 0;
+  for( uint i = 0; i < walk_repeats; i++ ) walk_sum += atomic_list1.size_exact();
+
+  time = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+  printf( "size_exact() of a list of %u elements: %u us (%s)\n", walk_list_size, (uint) time / walk_repeats,
+    walk_sum == walk_list_size * walk_repeats ? "ok" : "failed" );
+
+  //the same walk with iterators, a reference per hop
+  start = std::chrono::high_resolution_clock::now();
+
+  walk_sum = 0;
+  for( uint i = 0; i < walk_repeats; i++ ) {
+    for( auto it = atomic_list1.begin(); it; ++it ) walk_sum++;
+  }
+
+  time = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+  printf( "iterator walk of a list of %u elements: %u us (%s)\n", walk_list_size, (uint) time / walk_repeats,
+    walk_sum == walk_list_size * walk_repeats ? "ok" : "failed" );
+
+  //nearby positions: advance from the head against advance from a cursor
+  for( uint c = 0; c < 3; c++ ) {
+
+    atomic_list_t::cursor cursor0;
+
+    start = std::chrono::high_resolution_clock::now();
+
+    walk_sum = 0;
+    for( uint i = 0; i < cursor_walks; i++ ) {
+      uint index = i * ( walk_list_size / cursor_walks ) + i % 7;
+      auto it = c == 0 ? atomic_list1.advance( index ) : c == 1 ? atomic_list1.advance( cursor0, index ) : atomic_list1.advance_local( index );
+      walk_sum += *it == walk_list_size - 1 - index;
+    }
+
+    time = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+    printf( "%s of %u increasing positions: %u us (%s)\n", c == 0 ? "advance" : c == 1 ? "advance with a cursor" : "advance_local",
+      cursor_walks, (uint) time, walk_sum == cursor_walks ? "ok" : "failed" );
+  }
+
+  //export: one guarded pass into a vector
+  std::vector<uint> values;
+
+  start = std::chrono::high_resolution_clock::now();
+
+  walk_sum = 0;
+  for( uint i = 0; i < walk_repeats; i++ ) walk_sum += atomic_list1.snapshot_to( values );
+
+  time = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+  printf( "snapshot_to() of a list of %u elements: %u us (%s)\n", walk_list_size, (uint) time / walk_repeats,
+    walk_sum == walk_list_size * walk_repeats && values.front() == walk_list_size - 1 ? "ok" : "failed" );
+
+  atomic_list1.clear();
+
+  //bulk load: push_front per element against assign with a single update of the head
+  values.resize( bulk_size );
+  for( uint i = 0; i < bulk_size; i++ ) values[ i ] = i;
+
+  start = std::chrono::high_resolution_clock::now();
+
+  for( uint i = bulk_size; i-- > 0; ) atomic_list1.push_front( values[ i ] );
+
+  time = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+  printf( "\npush_front of %u elements: %u us\n", bulk_size, (uint) time );
+
+  start = std::chrono::high_resolution_clock::now();
+
+  atomic_list1.clear();
+
+  time = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+  printf( "clear of %u elements: %u us\n", bulk_size, (uint) time );
+
+  start = std::chrono::high_resolution_clock::now();
+
+  atomic_list1.assign( values );
+
+  time = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+  printf( "assign of %u elements: %u us\n", bulk_size, (uint) time );
+
+  std::vector<uint> values1;
+  atomic_list1.snapshot_to( values1 );
+
+  passed = values1 == values && atomic_list1.size() == bulk_size;
+  printf( "assign: %s\n", passed ? "Passed!" : "failed!" );
+
+  //the head fast path: pop_front marks the node and moves the head link past it
+  start = std::chrono::high_resolution_clock::now();
+
+  uint popped = 0;
+  passed = true;
+  while( auto it = atomic_list1.pop_front() ) passed = passed && *it == popped++;
+
+  time = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+  passed = passed && popped == bulk_size && atomic_list1.empty() && atomic_list1.size() == 0;
+  printf( "pop_front of %u elements: %u us (%s)\n", popped, (uint) time, passed ? "ok" : "failed" );
+
+  //the destructor releases the nodes iteratively
+  {
+    atomic_list_t atomic_list2;
+    atomic_list2.assign( values );
+    start = std::chrono::high_resolution_clock::now();
+  }
+
+  time = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+  printf( "destruction of a list of %u elements: %u us\n", bulk_size, (uint) time );
+
+  //expiry sweep: erase every odd element of a walk_list_size list in one pass
+  atomic_list1.assign( values.begin(), values.begin() + walk_list_size );
+
+  start = std::chrono::high_resolution_clock::now();
+
+  uint erased = atomic_list1.erase_if( []( uint value ) { return value % 2 == 1; } );
+
+  time = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+
+  atomic_list1.snapshot_to( values1 );
+  passed = erased == walk_list_size / 2 && values1.size() == walk_list_size / 2 && atomic_list1.size() == walk_list_size / 2;
+  for( uint i = 0; passed && i < values1.size(); i++ ) passed = values1[ i ] == i * 2;
+
+  printf( "\nerase_if of %u elements: %u us (%s)\n", erased, (uint) time, passed ? "ok" : "failed" );
+
+  //ranges: the odd elements are put back after every even one, then a second list is spliced
+  start = std::chrono::high_resolution_clock::now();
+
+  uint pos_value = 0;
+  for( auto it = atomic_list1.begin(); it; ++it, pos_value += 2 ) {
+    atomic_list1.insert_range_after( it, values.begin() + pos_value + 1, values.begin() + pos_value + 2 );
+    ++it;
+  }
+
+  time = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+
+  atomic_list_t atomic_list2;
+  atomic_list2.assign( values.begin() + walk_list_size, values.begin() + walk_list_size * 2 );
+
+  auto it_last = atomic_list1.advance( walk_list_size );
+  passed = atomic_list1.splice_after( it_last, atomic_list2 ) && atomic_list2.empty() && atomic_list2.size() == 0;
+
+  atomic_list1.snapshot_to( values1 );
+  passed = passed && atomic_list1.size() == walk_list_size * 2 && values1.size() == walk_list_size * 2;
+  for( uint i = 0; passed && i < values1.size(); i++ ) passed = values1[ i ] == i;
+
+  printf( "insert_range_after of %u ranges: %u us, splice_after: %s\n", walk_list_size / 2, (uint) time, passed ? "ok" : "failed" );
+
+  atomic_list1.clear();
+
+  //push_front never fails: concurrent pushes all land, none of them returns an empty iterator
+  std::atomic<uint> push_failed{ 0 };
+
+  auto fn_push = [ &atomic_list1, &push_failed ]() {
+    for( uint i = 0; i < iterations; i++ ) {
+      if( ! atomic_list1.push_front( i ) ) push_failed.fetch_add( 1 );
+    }
+  };
+
+  for( auto& thread : threads ) thread = std::thread{ fn_push };
+  for( auto& thread : threads ) thread.join();
+
+  passed = push_failed.load() == 0 && atomic_list1.size_exact() == threads_size * iterations;
+
+  printf( "push_front from %u threads: %s\n", threads_size, passed ? "ok" : "failed" );
+
+  atomic_list1.clear();
+
   printf( "\ndone\n" );
 
 }
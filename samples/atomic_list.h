@@ -4,19 +4,27 @@
 
 A singly linked list using atomic_data. This header is part of a test in atomic_list.cpp file.
 
-For lock-free lists we have to deal with the deletion problem. For this we employ a lock (just
-a bool field thanks to atomic_data) on the to be deleted node. 
-
-Iterator for atomic_list contains a shared_ptr referencing a list node.
+For lock-free lists we have to deal with the deletion problem. For this we mark the to be deleted
+node (a flag in the low bits of its next link, see tagged_ref in atomic_shared.h, published
+together with the link thanks to atomic_data): after that nothing can be inserted or erased after it. Then the link from the previous node is replaced,
+if that fails the node is unlinked later by a traversal (like in Harris' list).
+
+Iterator for atomic_list contains a reference to a list node. Nodes are reference counted
+intrusively (atomic_shared.h): the count lives in the node, so there is no separate control
+block and a hop of an iterator is an increment and a decrement of counts in the nodes.
 You can store and refer to it. If this node is deleted from the list then you won't be able to erroneously add 
-to it or remove it from the list again, because it's going to have the lock member variable set to true.
+to it or remove it from the list again, because it's going to have the locked flag (the mark) set.
+
+The link to the first node is not a part of a node but a single atomic word of the list: push_front
+is one CAS of it without atomic_data. pop_front still marks the node with an update (an iterator to it
+could be used to insert after it) and then moves the word past it with a CAS.
 
 API:
 
 types:
 
   - iterator
-  holds a shared_ptr to an atomic_data<node>, can be stored and passed around
+  holds a reference to an atomic_data<node>, can be stored and passed around
 
   accesing node data: auto data = *it;
   check if a node is locked: bool iterator::is_locked();
@@ -24,10 +32,18 @@ types:
   updating node data: bool iterator::update_weak( value ) ); //fails for various reasons
                       bool iterator::update( value ) ); //fails only if deleted
 
+  - cursor
+  a finger into the list for advance: remembers the last nodes reached through it with their
+  positions, a cursor used with another list is reset
+  the nodes are remembered weakly (no references): a cursor doesn't keep the nodes of an
+  erased element or of a destroyed list alive
+
 create instance:
 
-    - atomic_list< data_type, queue_length >
+    - atomic_list< data_type, queue_length, domain = void >
     where queue_length is passed to atomic_data, 8 by default
+    nodes come from a node pool (atomic_pool.h), the queue of atomic_data (and so the sync barrier)
+    and the pool are per node type: lists with different domain types don't share them
 
 methods:
 
@@ -38,30 +54,78 @@ methods:
 
   - iterator push_front( value ) 
   inserts a node at the head, never fails, returns an iterator to inserted element
+  a single CAS of the head link
+
+  - void assign( first, last )
+  - void assign( range )
+  replaces the elements of the list: the new chain of nodes is built privately and published
+  with a single update of the head, the nodes of the old chain are marked as deleted
+
+  - bool insert_range_after( iterator it, first, last )
+  inserts the elements after it with a single update of it, fails only if it is deleted
+
+  - bool splice_after( iterator it, atomic_list& other )
+  moves all nodes of other after it (iterators to them stay valid), fails only if it is deleted
+  (the nodes are then returned to the front of other), it must be a node of this list: concurrent
+  splices in both directions between two lists are not supported
 
   - iterator erase_after_weak( iterator it, value )
   removes a node after it and returns an iterator poiting to it
-  to do it it sets a locked bool field to true (with the help of atomic_data)
-  so all removed nodes have their locked variable set to true and can't be 
+  to do it it sets the locked and deleted flags (with the help of atomic_data)
+  so all removed nodes have their locked flag set and can't be 
   erroneously used for insertion or removal and you can safely store the returned
-  iterator
+  iterator, then it tries to unlink the node, find_if and advance unlink the marked nodes they meet
+  the link of it is checked in the marking update (a node inserted after it meanwhile is looked
+  at next), an insertion after it between the check and the publication of the mark is not seen:
+  the erased node was the one after it at the check
 
   - iterator pop_front( value )
-  removes a node at the head
+  removes a node at the head, an update of the node (the mark) and a CAS of the head link
+
+  - size_t erase_if( F )
+  erases the elements for which F( data_type const& ) returns true in a single forward pass,
+  returns the number of erased elements
 
   - iterator begin()
   - iterator end()
   standard methods, atomic_list can be used in range-based for loops
-  but remember that the first element is always present and is the head of the list
+  begin() is the first element (end() for an empty list), the head of the list is not an element
+  and there is no iterator to it: insert at the front with push_front, erase with pop_front
+
+  - void for_each( F )
+  - iterator find_if( F )
+  - iterator advance( size_t index )
+  borrowed traversal: the whole walk is a single read-side critical section (atomic_data guard),
+  next pointers are followed without taking references, deleted nodes are skipped
+  F accepts data_type const&, for find_if it returns true for the node to return
+  advance returns the node at index or the last one if the list is shorter (end() if it's empty)
+  only the returned node gets a reference, F must not update the list
+
+  - iterator advance( cursor&, size_t index )
+  - iterator advance_local( size_t index )
+  advance that starts from the nearest node of the cursor at or before index, a node that is
+  deleted, freed or now belongs to another list is dropped from the cursor and the one before it
+  is tried (the head is the last resort)
+  the positions are the ones the nodes had when they were reached: they drift with the insertions
+  and erasures before them, so the index is approximate while the list is updated
+  advance_local uses a cursor per thread (for the last list the thread has used it with)
 
   - size_t size()
-  get the number of nodes in the list
+  get the number of nodes in the list in O(1): a counter sharded between threads (atomic_counter.h)
+  that is updated on insert and erase, approximate while there are updates in flight
+
+  - size_t size_exact()
+  count the nodes with a borrowed traversal
+
+  - size_t snapshot_to( std::vector< data_type >& )
+  copies the elements to the vector (its old content is cleared) in one borrowed traversal
+  returns the number of elements
 
   - void clear()
-  remove nodes from the begining until nothing is left
+  detaches all nodes with a single update of the head and marks them as deleted
 
   - bool empty()
-  check if the list has elements
+  check if the list has elements (O(1), checks the link of the head)
 
 License: Public-domain Software.
 
@@ -71,24 +135,55 @@ Alexandr Poltavsky
 */
 
 
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
 #include "atomic_data.h"
-#include <memory>
+#include "atomic_shared.h"
+#include "atomic_pool.h"
+#include "atomic_counter.h"
 
-template< typename T0, unsigned N0 = 8 > struct atomic_list {
+template< typename T0, unsigned N0 = 8, typename D0 = void > struct atomic_list {
 
   static_assert( N0 > 1, "queue_size for the atomic_list must be greater than 1 because the remove() method requires 2 allocations from the queue." );
 
   struct node;
+  struct atomic_node;
 
-  using atomic_node = atomic_data<node, N0>;
-  using node_ptr = std::shared_ptr<atomic_node>;
+  using node_ptr = shared_ref<atomic_node>;
+  using next_link = tagged_ref<atomic_node>;
+  using guard = typename atomic_data<node, N0>::guard;
   using size_t = unsigned;
 
+  //the flags are kept in the low bits of the link to the next node: a node is data_type and a word
   struct node {
     T0 data;
-    node_ptr next;
-    bool locked;
-    bool deleted;
+    next_link next;
+
+    bool locked() const { return next.tag( 0 ); }
+    bool deleted() const { return next.tag( 1 ); }
+
+    void mark() {
+      next.set_tag( 0, true );
+      next.set_tag( 1, true );
+    }
+
+    static void* operator new( std::size_t ) { return atomic_pool<node>::allocate(); }
+    static void operator delete( void* object ) { atomic_pool<node>::deallocate( object ); }
+  };
+
+  //the reference count is a part of the node
+  //owner is the id of the list the node is linked into: the weak entries of a cursor are checked
+  //against it after the memory of the node was reused (see atomic_pool.h)
+  struct atomic_node : shared_base, atomic_data<node, N0> {
+
+    atomic_node( node* node0 = new node{ }, std::uint64_t owner_ = 0 ) : atomic_data<node, N0>{ node0 }, owner{ owner_ } { }
+
+    static void* operator new( std::size_t ) { return atomic_pool<atomic_node>::allocate(); }
+    static void operator delete( void* object ) { atomic_pool<atomic_node>::deallocate( object ); }
+
+    std::atomic<std::uint64_t> owner;
   };
 
   struct iterator {
@@ -96,7 +191,7 @@ template< typename T0, unsigned N0 = 8 > struct atomic_list {
     iterator operator++() {
       //safely acquire node_ptr to atomic_node using atomic_data->read method
       value = value->read( []( node* node0 ){
-          return node0->next;
+          return node0->next.ref();
       });
       return *this;
     }
@@ -104,7 +199,7 @@ template< typename T0, unsigned N0 = 8 > struct atomic_list {
     iterator operator++(int) {
       iterator it{ value };
       value = value->read( []( node* node0 ){
-          return node0->next;
+          return node0->next.ref();
       });
       return it;
     }
@@ -133,34 +228,92 @@ template< typename T0, unsigned N0 = 8 > struct atomic_list {
     template<typename U0>
     bool update_weak( U0 fn ) {
       return value->update_weak( [&fn]( node* node0 ){
-        if( node0->locked ) return false;
+        if( node0->locked() ) return false;
         return fn( & node0->data );
       });
     }
 
     bool is_locked() {
       return value && value->read( []( node* node0 ){
-          return node0->locked;
+          return node0->locked();
       });
     }
 
     bool is_deleted() {
       return value && value->read( []( node* node0 ){
-          return node0->deleted;
+          return node0->deleted();
       });
     }
 
     node_ptr value;
   };
 
+  //the entries are weak: a node is taken with try_share and checked to be still a node of the
+  //list, the entries of deleted nodes are dropped by advance, the oldest entry is replaced by a new one
+  struct cursor {
+
+    static const size_t history_size = 8;
+
+    struct entry {
+      atomic_node* value;
+      size_t index;
+    };
+
+    void reset( std::uint64_t owner_ ) {
+      for( auto& entry0 : history ) entry0.value = nullptr;
+      owner = owner_;
+    }
 
-  //empty node is our head of the list
+    void save( atomic_node* value, size_t index ) {
+      for( auto& entry0 : history ) {
+        if( entry0.value == value ) {
+          entry0.index = index;
+          return;
+        }
+      }
+      history[ next++ % history_size ] = { value, index };
+    }
+
+    entry history[ history_size ] = { };
+
+    size_t next = 0;
+    std::uint64_t owner = 0;
+  };
+
+
+  //empty node is our head of the list: only a position for the walks and the links of the list,
+  //its version holds no link (the first node is in the head word)
   atomic_list() : list{ new atomic_node{} }{ }
 
+  //the nodes are released one by one, a long chain of references would recurse
+  ~atomic_list() {
+    release( exchange( node_ptr{ } ) );
+  }
+
 
+  //Head Fast Path
+  //the link to the first node is a single word of the list (the head node is only a position for
+  //the walks): push_front is a CAS of the word, the new node adopts the reference of the list to
+  //the old first node, so there are no count updates; ABA is harmless: the new node is linked to
+  //whatever node is first at the moment of the CAS
   iterator push_front( T0 value ) {
-    auto it = iterator{ list };
-    return insert_after_weak( it, (T0&&) value );
+
+    node* node0 = new node{ (T0&&) value };
+    node_ptr node_new{ new atomic_node{ node0, id } };
+    iterator it{ node_new };
+
+    atomic_node* first0 = head.load( std::memory_order_relaxed );
+
+    while( true ) {
+      node0->next = node_ptr{ first0 };
+      if( head.compare_exchange_weak( first0, node_new.get(), std::memory_order_release, std::memory_order_relaxed ) ) break;
+      node0->next.detach();
+    }
+
+    node_new.detach();
+
+    counter.add( 1 );
+    return it;
   }
 
   iterator insert_after_weak( iterator& pos, T0 value ) {
@@ -168,14 +321,14 @@ template< typename T0, unsigned N0 = 8 > struct atomic_list {
     node_ptr node_new;
 
     //atomic_data->update_weak because the node at pos might be locked
-    bool r = pos.value->update_weak( [ &node_new, &value ]( node* node0 ) {
+    bool r = pos.value->update_weak( [ this, &node_new, &value ]( node* node0 ) {
 
       //if locked get out
-      if( node0->locked ) return false;
+      if( node0->locked() ) return false;
 
       //perform insertion
-      node *node_ = new node{ (T0&&) value, node0->next, false, false };
-      node_new.reset( new atomic_node{ node_ } );
+      node *node_ = new node{ (T0&&) value, node0->next.ref() };
+      node_new.reset( new atomic_node{ node_, id } );
       node0->next = node_new;
 
       //okay for update
@@ -183,104 +336,532 @@ template< typename T0, unsigned N0 = 8 > struct atomic_list {
 
     } );
 
-    return r ? iterator{node_new} : iterator{};
+    if( ! r ) return {};
+
+    counter.add( 1 );
+    return { node_new };
   }
 
-  iterator pop_front() {
-    auto pos = iterator{ list };
-    iterator it;
-    while( ! empty() && ! (it = erase_after_weak( pos )) );
-    return it;
+  //builds a private chain of nodes, tail is the data of the last one
+  //the chain is private until it's linked, so it's built without atomic_data updates
+  template< typename U0 >
+  node_ptr build( U0 first, U0 last, node*& tail, size_t& count ) const {
+
+    node_ptr chain;
+    tail = nullptr;
+    count = 0;
+
+    for( ; first != last; ++first, count++ ) {
+      node* node0 = new node{ *first, node_ptr{ } };
+      node_ptr node_new{ new atomic_node{ node0, id } };
+      if( tail ) tail->next = (node_ptr&&) node_new;
+      else chain = (node_ptr&&) node_new;
+      tail = node0;
+    }
+
+    return chain;
   }
 
-  iterator erase_after_weak( iterator& pos ) {
+  template< typename U0 >
+  void assign( U0 first, U0 last ) {
 
-    node_ptr node_next{};
+    node* tail;
+    size_t count;
+    node_ptr chain = build( first, last, tail, count );
 
-    //using update_weak on the node before one that we want to remove
-    //update_weak is reentrant
-    bool r = pos.value->update_weak( [&node_next]( node* node0 ) {
+    long count_old = release( exchange( (node_ptr&&) chain ) );
 
-      if( node0->locked ) return false;
+    counter.add( (long) count - count_old );
+  }
+
+  template< typename U0 >
+  void assign( U0 const& range ) {
+    assign( std::begin( range ), std::end( range ) );
+  }
 
-      node_next = node0->next;
+  template< typename U0 >
+  bool insert_range_after( iterator& pos, U0 first, U0 last ) {
 
-      if( ! node_next ) {
+    node* tail;
+    size_t count;
+    node_ptr chain = build( first, last, tail, count );
+
+    if( ! chain ) return true;
+
+    //the tail is still private, it's linked to the node after pos before the chain is published
+    while( true ) {
+      bool locked = false;
+      node_ptr after = next_of( pos.value.get(), locked );
+      if( locked ) {
+        tail->next.reset();
+        release( (node_ptr&&) chain );
         return false;
       }
-      
-      node_ptr node_after;
-
-      //try to lock the to be deleted node (next node)
-      bool r = node_next->update_weak( [ &node_after ]( node* node0 ) {
-        if( node0->locked ) return false;
-        node0->locked = true;
-        node_after = node0->next;
-        return true;
-      });
+      tail->next = after;
+      if( replace_next( pos.value.get(), after.get(), chain ) ) break;
+    }
 
-      if( ! r ) {
-        node_next = nullptr;
-        return false;
+    counter.add( (long) count );
+    return true;
+  }
+
+  bool splice_after( iterator& pos, atomic_list& other ) {
+
+    if( &other == this || pos.is_locked() ) return false;
+
+    node_ptr chain = other.exchange( node_ptr{ } );
+
+    size_t count = 0;
+    node_ptr after_last;
+
+    if( link( pos.value.get(), chain, count, after_last ) ) {
+      other.counter.add( - (long) count );
+      counter.add( (long) count );
+      return true;
+    }
+
+    //pos was erased meanwhile
+    other.link( other.list.get(), chain, count, after_last );
+    return false;
+  }
+
+  //links a detached chain after pos: first the last unmarked node of the chain gets the link to
+  //the node after pos (a marked tail is dropped with it), then pos gets the link to the chain
+  //the chain is walked under a guard, the updates are made without it (see scan)
+  //count is the number of unmarked nodes, fails only if pos is marked
+  //after_last is the node the last node was linked to on a failed attempt, the walk stops there
+  bool link( atomic_node* pos, node_ptr const& chain, size_t& count, node_ptr& after_last ) {
+
+    while( chain ) {
+
+      node_ptr last;
+      atomic_node* last_next = nullptr;
+      count = 0;
+
+      {
+        guard guard0{ };
+        for( atomic_node* it = chain.get(); it && it != after_last.get(); ) {
+          node* node0 = it->read( guard0, []( node* node1 ) { return node1; } );
+          it->owner.store( id, std::memory_order_relaxed );
+          if( ! node0->deleted() ) {
+            last = node_ptr::share( it );
+            last_next = node0->next.get();
+            count++;
+          }
+          it = node0->next.get();
+        }
       }
 
-      //delete
-      node0->next = node_after;
+      //only marked nodes
+      if( ! last ) return true;
+
+      bool locked = false;
+      node_ptr after = next_of( pos, locked );
+
+      if( locked ) return false;
 
-      //signal atomic_data that we're good to go
+      bool r = last->update_weak( [ last_next, &after ]( node* node0 ) {
+        if( node0->locked() || node0->next.get() != last_next ) return false;
+        node0->next = after;
+        return true;
+      } );
+
+      if( ! r ) continue;
+
+      after_last = after;
+
+      if( replace_next( pos, after.get(), chain ) ) return true;
+    }
+
+    return true;
+  }
+
+  //replaces the chain after the head, returns the old one
+  node_ptr exchange( node_ptr chain ) {
+    return node_ptr{ head.exchange( chain.detach(), std::memory_order_acq_rel ) };
+  }
+
+  //the reference of the list to the first node can be dropped at any moment: the count is taken
+  //only if it isn't zero yet (the node pool keeps the memory of a freed node intact and of the same
+  //type), then the node is checked to be still the first one
+  node_ptr acquire_first() const {
+    while( true ) {
+      atomic_node* first0 = head.load( std::memory_order_acquire );
+      if( ! first0 ) return { };
+      node_ptr r = node_ptr::try_share( first0 );
+      if( r && head.load( std::memory_order_acquire ) == first0 ) return r;
+    }
+  }
+
+  //the link after pos (the first node for the head), locked is the mark of pos
+  node_ptr next_of( atomic_node* pos, bool& locked ) const {
+    if( pos == list.get() ) {
+      locked = false;
+      return acquire_first();
+    }
+    return pos->read( [ &locked ]( node* node0 ) {
+      locked = node0->locked();
+      return node0->next.ref();
+    } );
+  }
+
+  //replaces the link after pos if it's still expected and pos isn't marked
+  bool replace_next( atomic_node* pos, atomic_node* expected, node_ptr desired ) const {
+
+    if( pos == list.get() ) {
+      if( ! head.compare_exchange_strong( expected, desired.get(), std::memory_order_acq_rel ) ) return false;
+      desired.detach();
+      node_ptr{ expected };
       return true;
+    }
 
-    });
+    return pos->update_weak( [ expected, &desired ]( node* node0 ) {
+      if( node0->locked() || node0->next.get() != expected ) return false;
+      node0->next = desired;
+      return true;
+    } );
+  }
 
+  //marks the nodes of a detached chain as deleted and drops their links in order (an iterator
+  //kept to one of them can't insert or erase after it anymore), returns how many were not marked yet
+  static size_t release( node_ptr it ) {
+    size_t count = 0;
+    while( it ) {
+      node_ptr next;
+      bool marked = false;
+      it->update( [ &next, &marked ]( node* node0 ) {
+        marked = node0->locked();
+        next = node0->next.ref();
+        node0->next.reset();
+        node0->mark();
+        return true;
+      } );
+      if( ! marked ) count++;
+      it = (node_ptr&&) next;
+    }
+    return count;
+  }
+
+  //the first node is marked (an iterator to it might be used for an insertion after it) and the
+  //word is moved past it with a CAS, a node marked by an erasure elsewhere is unlinked and skipped
+  iterator pop_front() {
+
+    while( true ) {
+
+      node_ptr node0 = acquire_first();
 
-    if( ! r ) {
+      if( ! node0 ) return {};
+
+      bool marked = false;
+
+      bool r = node0->update_weak( [ &marked ]( node* node1 ) {
+        marked = node1->locked();
+        if( marked ) return false;
+        node1->mark();
+        return true;
+      } );
 
-      //unlock if we successfully locked and still failed to update
-      if( node_next ) {
-        node_next->update( []( node* node0 ) {
-          node0->locked = false;
-          return true;
-        } );
+      if( r || marked ) unlink( list.get(), node0.get() );
+
+      if( r ) {
+        counter.add( -1 );
+        return { node0 };
       }
+    }
+  }
 
-      return {};
-    } 
+  iterator erase_after_weak( iterator& pos ) {
 
-    //mark as deleted
-    node_next->update( []( node* node0 ) {
-      node0->deleted = true;
-      return true;
+    while( true ) {
+
+      //the node to delete, pos must not be deleted itself
+      bool locked = false;
+      node_ptr node_next = next_of( pos.value.get(), locked );
+
+      if( locked || ! node_next ) return {};
+
+      //logical deletion: a single update marks the node (locked and deleted are published together
+      //with its next link), after that nothing is inserted or erased after it and its next never changes
+      //the mark is never rolled back
+      //the link of pos is checked in the update: if a node was inserted after pos (or pos was erased)
+      //since it was read, the node isn't marked and the next one is looked up again
+      bool moved = false;
+      bool r = node_next->update_weak( [ this, &pos, &node_next, &moved ]( node* node0 ) {
+        if( node0->locked() ) return false;
+        moved = ! is_next( pos.value.get(), node_next.get() );
+        if( moved ) return false;
+        node0->mark();
+        return true;
+      } );
+
+      if( moved ) continue;
+
+      //physical deletion, also helps if someone else has marked the node
+      //on failure the node stays linked until a later traversal snips it
+      unlink( pos.value.get(), node_next.get() );
+
+      if( ! r ) return {};
+
+      counter.add( -1 );
+      return { node_next };
+    }
+  }
+
+  //checks that the link after pos is node_next and pos isn't marked
+  bool is_next( atomic_node* pos, atomic_node* node_next ) const {
+    if( pos == list.get() ) return head.load( std::memory_order_acquire ) == node_next;
+    return pos->read( [ node_next ]( node* node0 ) {
+      return ! node0->locked() && node0->next.get() == node_next;
     } );
+  }
+
+  //the matching nodes are collected by a borrowed traversal in batches, then marked and unlinked
+  //without the guard, the next batch is looked for after the last node of the previous one
+  template< typename U0 >
+  size_t erase_if( U0 fn ) {
+
+    static const size_t batch_size = 64;
+
+    node_ptr batch[ batch_size ];
+    node_ptr prevs[ batch_size ];
+    node_ptr first = list;
+    size_t count = 0;
+
+    //the last erased node and the node before it: the previous node of a run of erased nodes
+    node_ptr erased;
+    node_ptr erased_prev;
+
+    while( first ) {
+
+      size_t size = 0;
+
+      {
+        guard guard0{ };
+        atomic_node* prev = first.get();
+        scan( guard0, [ &fn, &batch, &prevs, &size, &prev ]( atomic_node* it, node* node0 ) {
+          if( fn( (T0 const&) node0->data ) ) {
+            batch[ size ] = node_ptr::share( it );
+            prevs[ size ] = node_ptr::share( prev );
+            size++;
+          }
+          prev = it;
+          return size < batch_size;
+        }, false, first.get() );
+      }
+
+      for( size_t i = 0; i < size; i++ ) {
+
+        node_ptr& prev = prevs[ i ] == erased ? erased_prev : prevs[ i ];
 
-    return {node_next};
+        //the data might have been updated since it was read
+        bool skip = false;
+        bool r = false;
+        while( ! r && ! skip ) {
+          r = batch[ i ]->update_weak( [ &fn, &skip ]( node* node0 ) {
+            skip = node0->locked() || ! fn( (T0 const&) node0->data );
+            if( skip ) return false;
+            node0->mark();
+            return true;
+          } );
+        }
+
+        if( ! r ) continue;
+
+        count++;
+        counter.add( -1 );
+        unlink( prev.get(), batch[ i ].get() );
+
+        erased_prev = prev;
+        erased = batch[ i ];
+      }
+
+      first = size == batch_size ? batch[ size - 1 ] : node_ptr{ };
+      for( size_t i = 0; i < size; i++ ) batch[ i ].reset(), prevs[ i ].reset();
+    }
+
+    return count;
+  }
+
+  //replaces the link from prev to a marked node with the link to the node after it
+  bool unlink( atomic_node* prev, atomic_node* node_marked ) const {
+
+    node_ptr node_after;
+
+    bool marked = node_marked->read( [ &node_after ]( node* node0 ) {
+      node_after = node0->next.ref();
+      return node0->locked();
+    } );
+
+    if( ! marked ) return false;
+
+    return replace_next( prev, node_marked, (node_ptr&&) node_after );
   }
 
   iterator begin() const { 
-    return ++iterator{ list };
+    return { acquire_first() };
   }
 
   iterator end() const { return {}; }
 
+  //Borrowed Traversal
+  //versions of nodes read under the guard are not reused by writers and their next references keep
+  //the following nodes alive, so raw pointers stay valid until the guard is gone
+  //fn( atomic_node*, node* ) returns false to stop at a node, returns that node or nullptr
+  //with snip the marked nodes on the way are unlinked (the next of a marked node never changes,
+  //so the walk goes on from it), update_weak under the guard fails at the sync barrier: it's best effort
+  //the walk starts after from (the head by default), the first node is held by a reference (the
+  //link of the head is not a part of a version): pass first to keep it after the walk
+  template< typename U0 >
+  atomic_node* scan( guard const& guard0, U0 fn, bool snip = false, atomic_node* from = nullptr, node_ptr* first = nullptr ) const {
+    atomic_node* prev = from ? from : list.get();
+    node_ptr first0;
+    node_ptr& hold = first ? *first : first0;
+    node* node0 = nullptr;
+    atomic_node* it;
+    if( prev == list.get() ) {
+      hold = acquire_first();
+      it = hold.get();
+    } else {
+      node0 = prev->read( guard0, []( node* node1 ) { return node1; } );
+      it = node0->next.get();
+    }
+    for( ; it; it = node0->next.get() ) {
+      node0 = it->read( guard0, []( node* node1 ) { return node1; } );
+      if( node0->deleted() ) {
+        if( snip ) unlink( prev, it );
+        continue;
+      }
+      if( ! fn( it, node0 ) ) return it;
+      prev = it;
+    }
+    return nullptr;
+  }
+
+  template< typename U0 >
+  void for_each( U0 fn ) const {
+    guard guard0{ };
+    scan( guard0, [ &fn ]( atomic_node*, node* node0 ) {
+      fn( (T0 const&) node0->data );
+      return true;
+    } );
+  }
+
+  template< typename U0 >
+  iterator find_if( U0 fn ) const {
+    guard guard0{ };
+    node_ptr first;
+    atomic_node* it = scan( guard0, [ &fn ]( atomic_node*, node* node0 ) {
+      return ! fn( (T0 const&) node0->data );
+    }, true, nullptr, &first );
+    return { node_ptr::share( it ) };
+  }
+
+  iterator advance( size_t index ) const {
+    guard guard0{ };
+    node_ptr first;
+    atomic_node* last = nullptr;
+    atomic_node* it = scan( guard0, [ &index, &last ]( atomic_node* it, node* ) {
+      last = it;
+      return index-- > 0;
+    }, true, nullptr, &first );
+    return { node_ptr::share( it ? it : last ) };
+  }
+
+  iterator advance( cursor& cursor0, size_t index ) const {
+
+    if( cursor0.owner != id ) cursor0.reset( id );
+
+    //the nearest entry at or before index that is not deleted: the node might have been freed
+    //(try_share fails) or reused by another list or for another element (the owner or the mark
+    //show it, a reused node of this list is only at a different position)
+    typename cursor::entry* from;
+    node_ptr from_node;
+
+    while( true ) {
+      from = nullptr;
+      for( auto& entry0 : cursor0.history ) {
+        if( entry0.value && entry0.index <= index && ( ! from || entry0.index > from->index ) ) from = &entry0;
+      }
+      if( ! from ) break;
+      from_node = node_ptr::try_share( from->value );
+      if( from_node && from_node->owner.load( std::memory_order_relaxed ) == id &&
+          ! from_node->read( []( node* node0 ) { return node0->deleted(); } ) ) break;
+      from_node.reset();
+      from->value = nullptr;
+    }
+
+    if( from && from->index == index ) return { from_node };
+
+    //the head is before the first element
+    size_t steps = from ? index - from->index : index + 1;
+    size_t reached = 0;
+    atomic_node* last = nullptr;
+
+    guard guard0{ };
+    node_ptr first;
+
+    atomic_node* it = scan( guard0, [ steps, &reached, &last ]( atomic_node* it, node* ) {
+      last = it;
+      return ++reached < steps;
+    }, true, from ? from_node.get() : list.get(), &first );
+
+    if( ! it && ! last ) return { from_node };
+
+    node_ptr value = node_ptr::share( it ? it : last );
+    cursor0.save( value.get(), from ? from->index + reached : reached - 1 );
+
+    return { value };
+  }
+
+  iterator advance_local( size_t index ) const {
+    thread_local cursor cursor0;
+    return advance( cursor0, index );
+  }
+
+  static std::uint64_t next_id() {
+    static std::atomic<std::uint64_t> ids{ 1 };
+    return ids.fetch_add( 1, std::memory_order_relaxed );
+  }
+
+  //the count is updated after the insertion or the mark, so it's exact when nothing is in flight
   size_t size() const {
+    return (size_t) counter.load();
+  }
+
+  size_t size_exact() const {
     size_t count = 0;
-    for( auto it = begin(); it; ++it ) {
-      count++;
-    }
+    for_each( [ &count ]( T0 const& ) { count++; } );
     return count;
   }
 
+  size_t snapshot_to( std::vector<T0>& data ) const {
+    data.clear();
+    data.reserve( size() );
+    for_each( [ &data ]( T0 const& value ) { data.push_back( value ); } );
+    return (size_t) data.size();
+  }
+
   void clear() {
-    while( pop_front() );
+    counter.add( - (long) release( exchange( node_ptr{ } ) ) );
   }
 
-  bool empty() {
-    return ! list->read( []( node* node0 ) {
-      return (bool) node0->next;
-    });
+  bool empty() const {
+    return ! head.load( std::memory_order_acquire );
   }
 
+  sharded_counter<> counter;
+
+  //cursors are tied to a list by its id
+  std::uint64_t id = next_id();
+
+private:
+
+  //the head node is not a part of the public surface: an iterator to it couldn't be advanced
   node_ptr list;
 
+  //the link to the first node, owns a reference
+  mutable std::atomic<atomic_node*> head{ nullptr };
+
 };
 
 
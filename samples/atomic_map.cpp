@@ -3,6 +3,9 @@
 Here we use an atomic_data< std::map<int, int> >.
 Threads use their id to access and increment their map locations.
 
+The second run uses an arena_map (atomic_arena.h): every queue slot owns an arena
+the map nodes are allocated from, so copying the map on update doesn't go to the heap.
+
 License: Public-domain Software.
 
 Blog post: http://alexpolt.github.io/atomic-data.html
@@ -16,12 +19,15 @@ Alexandr Poltavsky
 #include <map>
 
 #include "atomic_data.h"
+#include "atomic_data_std.h"
 #include "atomic_data_mutex.h"
+#include "atomic_arena.h"
 
 namespace {
 
   using uint = unsigned;
   using map = std::map<uint, uint>;
+  using arena_map_t = arena_map<uint, uint>;
 
   //edit to change the test setup
   const uint cycles_update = 102400;
@@ -38,6 +44,9 @@ int main() {
   //an instance of atomic_data<map>
   atomic_data<map, threads_size*2> atomic_map{};
 
+  //the same with nodes allocated from per-slot arenas
+  atomic_data<arena_map_t, threads_size*2> atomic_map_arena{};
+
   //the same using mutex
   atomic_data_mutex<map> atomic_map_mutex{};
 
@@ -47,6 +56,9 @@ int main() {
   printf( "\nstart testing atomic_map\n" );
   test_atomic_map( atomic_map );
 
+  printf( "\nstart testing atomic_map_arena\n" );
+  test_atomic_map( atomic_map_arena );
+
   printf( "\nstart testing atomic_map_mutex\n" );
   test_atomic_map( atomic_map_mutex );
 
@@ -54,12 +66,13 @@ int main() {
 
 //test function 
 //creates thread_size threads with a functor as an argument and calcs the time
+//functors are generic to accept both std::map and arena_map containers
 template< typename T >
 void test_atomic_map( T& atomic_map ) {
 
   auto update = [ &atomic_map ]( uint thread_id ) {
 
-    auto fn = [=]( map* data ) {
+    auto fn = [=]( auto* data ) {
       auto i = data->find( thread_id );
       if( i != data->end() ) {
         (*i).second++;
@@ -79,7 +92,7 @@ void test_atomic_map( T& atomic_map ) {
 
   auto read = [ &atomic_map ]( uint thread_id ) {
 
-    auto fn = [=]( map* data ) {
+    auto fn = [=]( auto* data ) {
       auto i = data->find( thread_id );
       if( i != data->end() ) {
         return (*i).second;
@@ -95,7 +108,7 @@ void test_atomic_map( T& atomic_map ) {
   };
 
   //clear the map
-  atomic_map.update( []( map* map0 ){
+  atomic_map.update( []( auto* map0 ){
     map0->clear();
     return true;
   });
@@ -118,7 +131,7 @@ void test_atomic_map( T& atomic_map ) {
 
   printf( "check # of increments = %d\n\n", cycles_update );
 
-  atomic_map.read( []( map* map0 ){ 
+  atomic_map.read( []( auto* map0 ){ 
     for( auto& i : *map0 ) {
       printf( "thread %d -> %d increments\n", i.first, i.second );
     }
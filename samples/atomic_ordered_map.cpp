@@ -0,0 +1,220 @@
+/*
+
+atomic_ordered_map against atomic_data< std::map > and atomic_data_mutex< std::map > on a
+table of 100K keys (the sizes can be edited).
+
+Updater threads insert random keys or assign to them, reader threads take a snapshot and
+sum the values of a range of keys. atomic_data< std::map > copies the whole table on every
+insert, atomic_ordered_map copies one path from the root to a leaf.
+At the end we check that no updates are lost and compare a range scan with std::map after
+a series of inserts and erases.
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <map>
+
+#include "atomic_data.h"
+#include "atomic_data_std.h"
+#include "atomic_data_mutex.h"
+#include "atomic_ordered_map.h"
+
+namespace {
+
+  using uint = unsigned;
+
+  //edit to change the test setup
+  const uint iterations = 256;
+  const uint threads_size = 4;
+  const uint sizes[] = { 1000, 10000, 100000 };
+  const uint range_size = 100;
+
+  using map = std::map<uint, uint>;
+  using atomic_map_t = atomic_data<map, threads_size * 2>;
+  using atomic_map_mutex_t = atomic_data_mutex<map>;
+  using atomic_ordered_map_t = atomic_ordered_map<uint, uint, std::less<uint>, threads_size * 2>;
+
+  volatile uint global_dummy;
+
+  //the same syntax for both map types
+  void increment( map* map0, uint key ) {
+    (*map0)[ key ]++;
+  }
+
+  void increment( atomic_ordered_map_t::version* map0, uint key ) {
+    uint const* value = map0->find( key );
+    map0->insert_or_assign( key, value ? *value + 1 : 1 );
+  }
+
+  uint sum_range( map const* map0, uint first, uint last ) {
+    uint sum = 0;
+    for( auto i = map0->lower_bound( first ); i != map0->end() && i->first < last; ++i ) sum += i->second;
+    return sum;
+  }
+
+  uint sum_range( atomic_ordered_map_t::version const* map0, uint first, uint last ) {
+    uint sum = 0;
+    map0->for_each( first, last, [ &sum ]( uint, uint value ) { sum += value; } );
+    return sum;
+  }
+
+  //the readers of atomic_ordered_map scan a snapshot, outside of read
+  template< typename T > uint read_range( T& map0, uint first, uint last ) {
+    return map0.read( [ first, last ]( map* map1 ) { return sum_range( map1, first, last ); } );
+  }
+
+  template<> uint read_range( atomic_ordered_map_t& map0, uint first, uint last ) {
+    atomic_ordered_map_t::version snapshot = map0.snapshot();
+    return sum_range( &snapshot, first, last );
+  }
+
+  template< typename T > uint sum( T* map0 ) {
+    return sum_range( map0, 0, ~0u );
+  }
+
+}
+
+template< typename T, typename U > uint test_map( T& map0, uint size );
+bool test_ordered();
+
+int main() {
+
+  printf( "Test parameters:\n\tCPU: %d core(s)\n\tupdates/thread: %d\n\tthreads: %d\n\trange: %d keys\n\n",
+    std::thread::hardware_concurrency(), iterations, threads_size, range_size );
+
+  printf( "time in microseconds\n" );
+  printf( "%10s %12s %18s %20s\n", "size", "atomic_map", "atomic_map_mutex", "atomic_ordered_map" );
+
+  for( uint size : sizes ) {
+
+    atomic_map_t atomic_map;
+    uint time_map = test_map<atomic_map_t, map>( atomic_map, size );
+
+    atomic_map_mutex_t atomic_map_mutex;
+    uint time_map_mutex = test_map<atomic_map_mutex_t, map>( atomic_map_mutex, size );
+
+    atomic_ordered_map_t atomic_ordered_map0;
+    uint time_ordered_map = test_map<atomic_ordered_map_t, atomic_ordered_map_t::version>( atomic_ordered_map0, size );
+
+    printf( "%10u %12u %18u %20u\n", size, time_map, time_map_mutex, time_ordered_map );
+  }
+
+  if( test_ordered() ) printf( "\nPassed!\n" );
+
+  printf( "\ndone\n" );
+}
+
+//test function
+//fills the map with even keys, half of the threads increment the values of random keys (a half
+//of them new odd keys), the other half sum the values of random ranges, returns the time
+template< typename T, typename U >
+uint test_map( T& map0, uint size ) {
+
+  map0.update( [ size ]( U* map1 ) {
+    for( uint i = 0; i < size; i++ ) increment( map1, i * 2 );
+    return true;
+  } );
+
+  //cycle the queue: it still holds the versions of the previous run (atomic_data queues are per type)
+  for( uint i = 0; i < threads_size * 4; i++ ) map0.update( []( U* ) { return true; } );
+
+  auto update = [ &map0, size ]() {
+    auto seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    std::mt19937_64 gen0( seed );
+    std::uniform_int_distribution<uint> engine0{ 0, size * 2 - 1 };
+
+    for( uint i = 0; i < iterations; i++ ) {
+      uint key = engine0( gen0 );
+      map0.update( [ key ]( U* map1 ) {
+        increment( map1, key );
+        return true;
+      } );
+    }
+  };
+
+  auto read = [ &map0, size ]() {
+    auto seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    std::mt19937_64 gen0( seed );
+    std::uniform_int_distribution<uint> engine0{ 0, size * 2 - 1 };
+
+    for( uint i = 0; i < iterations; i++ ) {
+      uint first = engine0( gen0 );
+      global_dummy = read_range( map0, first, first + range_size );
+      std::this_thread::yield();
+    }
+  };
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  std::thread threads[ threads_size ];
+  for( uint i = 0; i < threads_size; i++ ) threads[ i ] = i % 2 == 0 ? std::thread{ update } : std::thread{ read };
+  for( auto& thread : threads ) thread.join();
+
+  uint time = (uint) std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+
+  uint total = size + iterations * ( threads_size / 2 );
+  uint sum0 = map0.read( []( U* map1 ) { return sum( map1 ); } );
+  if( sum0 != total ) printf( "failed! sum = %u, expected %u\n", sum0, total );
+
+  return time;
+}
+
+//inserts and erases random keys in both maps, keeps an old snapshot, then compares the contents
+bool test_ordered() {
+
+  const uint keys = 20000;
+
+  map map0;
+  atomic_ordered_map_t atomic_ordered_map0;
+
+  std::mt19937_64 gen0( 1 );
+  std::uniform_int_distribution<uint> engine0{ 0, keys - 1 };
+
+  for( uint i = 0; i < keys; i++ ) {
+    uint key = engine0( gen0 );
+    map0[ key ] = i;
+    atomic_ordered_map0.insert_or_assign( key, i );
+  }
+
+  atomic_ordered_map_t::version snapshot = atomic_ordered_map0.snapshot();
+  map map1 = map0;
+
+  for( uint i = 0; i < keys * 2; i++ ) {
+    uint key = engine0( gen0 );
+    if( map0.erase( key ) != (size_t) atomic_ordered_map0.erase( key ) ) {
+      printf( "failed! erase %u\n", key );
+      return false;
+    }
+  }
+
+  auto compare = []( map const& map2, atomic_ordered_map_t::version const& map3 ) {
+    if( map2.size() != map3.size() ) return false;
+    auto i = map2.begin();
+    for( auto entry : map3 ) {
+      if( i->first != entry.first || i->second != entry.second ) return false;
+      ++i;
+    }
+    return sum_range( &map2, keys / 4, keys / 2 ) == sum_range( &map3, keys / 4, keys / 2 );
+  };
+
+  if( ! compare( map0, atomic_ordered_map0.snapshot() ) ) {
+    printf( "failed! the map doesn't match std::map after erases\n" );
+    return false;
+  }
+
+  if( ! compare( map1, snapshot ) ) {
+    printf( "failed! the snapshot changed\n" );
+    return false;
+  }
+
+  return true;
+}
+
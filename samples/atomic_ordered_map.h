@@ -0,0 +1,410 @@
+#pragma once
+
+/*
+
+A persistent ordered map (a path-copying B+ tree) using atomic_data.
+
+atomic_data< std::map > copies the whole map on every update. atomic_ordered_map keeps its
+entries in a wide B+ tree of reference counted nodes (atomic_shared.h): keys and values in
+the leaves, separator keys in the inner nodes. Published nodes are never modified, an update
+copies one root-to-leaf path (plus a sibling on a split or merge) and shares the rest.
+Nodes created by the same update are modified in place, so bulk loads don't copy paths.
+
+The root is published through atomic_data. A reader can take a snapshot (a version holding
+a reference to the root) and iterate it, a range scan included, without blocking writers
+and without being affected by them.
+
+API:
+
+create instance:
+
+  - atomic_ordered_map< key_type, value_type, compare = std::less< key_type >, queue_size = 8, node_size = 64 >
+  queue_size is passed to atomic_data, node_size is the maximum number of entries in a node
+
+types:
+
+  - version
+  an immutable snapshot of the map that is passed to the functors, copying it is cheap:
+
+    - value_type const* find( key_type const& key ) const
+    returns nullptr if there is no such key
+
+    - void insert_or_assign( key_type const& key, value_type value )
+    - bool erase( key_type const& key )
+    modify the version, only available in update
+
+    - iterator begin() const, end() const, lower_bound( key_type const& key ) const
+    iterators to the entries in key order, *it returns a pair of references to the key and the value
+    valid while the version is alive
+
+    - void for_each( key_type const& first, key_type const& last, F ) const
+    calls F( key, value ) for the keys in [first, last)
+
+    - size_t size() const
+
+methods:
+
+  - void update( F )
+  - bool update_weak ( F )
+  - auto read( F )
+  the same as for atomic_data, F accepts a version*
+
+  - version snapshot() const
+  a copy of the current version that can be kept and iterated without blocking writers
+
+  - void insert_or_assign( key_type const& key, value_type value )
+  - bool erase( key_type const& key )
+  - bool find( key_type const& key, value_type& value ) const
+  - size_t size() const
+  shortcuts for single operations
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstddef>
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+
+#include "atomic_data.h"
+#include "atomic_shared.h"
+
+
+template< typename K0, typename V0, typename C0 = std::less<K0>, unsigned N0 = 8, unsigned B0 = 64 >
+struct atomic_ordered_map {
+
+  static_assert( B0 >= 4, "node_size for the atomic_ordered_map must be at least 4" );
+
+  using size_t = std::size_t;
+
+  struct node;
+  using node_ref = shared_ref<node>;
+
+  //leaves hold keys and values, inner nodes hold children and keys.size() + 1 == children.size()
+  //all keys in children[ i ] are less than keys[ i ] and all keys in children[ i + 1 ] are not
+  struct node : shared_base {
+
+    size_t size() const { return leaf ? keys.size() : children.size(); }
+
+    bool leaf = true;
+    std::vector<K0> keys;
+    std::vector<V0> values;
+    std::vector<node_ref> children;
+  };
+
+
+  //Tree Operations
+  //a node is modified in place only if this version is its single owner (created by this update),
+  //nodes shared with other versions are copied first, so published nodes never change
+
+  static void make_unique( node_ref& node0 ) {
+    if( ! node0.unique() ) node0 = node_ref{ new node( *node0 ) };
+  }
+
+  static size_t child_index( node const* node0, K0 const& key ) {
+    return std::upper_bound( node0->keys.begin(), node0->keys.end(), key, C0{ } ) - node0->keys.begin();
+  }
+
+  static size_t key_index( node const* node0, K0 const& key ) {
+    return std::lower_bound( node0->keys.begin(), node0->keys.end(), key, C0{ } ) - node0->keys.begin();
+  }
+
+  static V0 const* find( node const* node0, K0 const& key ) {
+    while( ! node0->leaf ) node0 = node0->children[ child_index( node0, key ) ].get();
+    size_t i = key_index( node0, key );
+    if( i < node0->keys.size() && ! C0{ }( key, node0->keys[ i ] ) ) return &node0->values[ i ];
+    return nullptr;
+  }
+
+  //moves the upper half of an overflowed child into a new right sibling
+  static void split_child( node* node0, size_t i ) {
+
+    node* child = node0->children[ i ].get();
+    node_ref right{ new node };
+    right->leaf = child->leaf;
+
+    K0 separator;
+
+    if( child->leaf ) {
+      size_t mid = child->keys.size() / 2;
+      right->keys.assign( std::make_move_iterator( child->keys.begin() + mid ), std::make_move_iterator( child->keys.end() ) );
+      right->values.assign( std::make_move_iterator( child->values.begin() + mid ), std::make_move_iterator( child->values.end() ) );
+      child->keys.resize( mid );
+      child->values.resize( mid );
+      separator = right->keys[ 0 ];
+    } else {
+      size_t mid = child->keys.size() / 2;
+      separator = (K0&&) child->keys[ mid ];
+      right->keys.assign( std::make_move_iterator( child->keys.begin() + mid + 1 ), std::make_move_iterator( child->keys.end() ) );
+      right->children.assign( std::make_move_iterator( child->children.begin() + mid + 1 ), std::make_move_iterator( child->children.end() ) );
+      child->keys.resize( mid );
+      child->children.resize( mid + 1 );
+    }
+
+    node0->keys.insert( node0->keys.begin() + i, (K0&&) separator );
+    node0->children.insert( node0->children.begin() + i + 1, (node_ref&&) right );
+  }
+
+  //returns true if the key was added
+  static bool insert( node_ref& node0, K0 const& key, V0& value ) {
+
+    make_unique( node0 );
+
+    node* node1 = node0.get();
+
+    if( node1->leaf ) {
+      size_t i = key_index( node1, key );
+      if( i < node1->keys.size() && ! C0{ }( key, node1->keys[ i ] ) ) {
+        node1->values[ i ] = (V0&&) value;
+        return false;
+      }
+      node1->keys.insert( node1->keys.begin() + i, key );
+      node1->values.insert( node1->values.begin() + i, (V0&&) value );
+      return true;
+    }
+
+    size_t i = child_index( node1, key );
+    bool added = insert( node1->children[ i ], key, value );
+    if( node1->children[ i ]->size() > B0 ) split_child( node1, i );
+    return added;
+  }
+
+  //an empty child is removed, a small one is merged with a sibling if they fit in one node
+  static void rebalance( node* node0, size_t i ) {
+
+    node const* child = node0->children[ i ].get();
+
+    if( child->size() == 0 ) {
+      node0->children.erase( node0->children.begin() + i );
+      if( ! node0->keys.empty() ) node0->keys.erase( node0->keys.begin() + ( i > 0 ? i - 1 : 0 ) );
+      return;
+    }
+
+    if( child->size() > B0 / 4 || node0->children.size() < 2 ) return;
+
+    size_t left = i > 0 ? i - 1 : i;
+    node const* right = node0->children[ left + 1 ].get();
+
+    if( node0->children[ left ]->size() + right->size() > B0 ) return;
+
+    make_unique( node0->children[ left ] );
+    node* merged = node0->children[ left ].get();
+
+    if( merged->leaf ) {
+      merged->keys.insert( merged->keys.end(), right->keys.begin(), right->keys.end() );
+      merged->values.insert( merged->values.end(), right->values.begin(), right->values.end() );
+    } else {
+      merged->keys.push_back( node0->keys[ left ] );
+      merged->keys.insert( merged->keys.end(), right->keys.begin(), right->keys.end() );
+      merged->children.insert( merged->children.end(), right->children.begin(), right->children.end() );
+    }
+
+    node0->keys.erase( node0->keys.begin() + left );
+    node0->children.erase( node0->children.begin() + left + 1 );
+  }
+
+  //the key must be present (checked with find), otherwise the path would be copied for nothing
+  static void erase( node_ref& node0, K0 const& key ) {
+
+    make_unique( node0 );
+
+    node* node1 = node0.get();
+
+    if( node1->leaf ) {
+      size_t i = key_index( node1, key );
+      node1->keys.erase( node1->keys.begin() + i );
+      node1->values.erase( node1->values.begin() + i );
+      return;
+    }
+
+    size_t i = child_index( node1, key );
+    erase( node1->children[ i ], key );
+    rebalance( node1, i );
+  }
+
+
+  //Iterator
+  //a path from the root to a leaf entry, holds raw pointers: valid while the version is alive
+  struct iterator {
+
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::pair<K0 const&, V0 const&>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = value_type;
+
+    std::pair<K0 const&, V0 const&> operator*() const {
+      auto& top = path.back();
+      return { top.first->keys[ top.second ], top.first->values[ top.second ] };
+    }
+
+    iterator& operator++() {
+      path.back().second++;
+      normalize();
+      return *this;
+    }
+
+    iterator operator++( int ) {
+      iterator it = *this;
+      ++*this;
+      return it;
+    }
+
+    bool operator==( iterator const& other ) const { return path == other.path; }
+    bool operator!=( iterator const& other ) const { return !operator==( other ); }
+
+    //descends to the leftmost leaf of the current child
+    void descend() {
+      while( ! path.back().first->leaf ) {
+        auto& top = path.back();
+        path.push_back( { top.first->children[ top.second ].get(), 0 } );
+      }
+    }
+
+    //moves past the ends of the nodes, the end iterator has an empty path
+    void normalize() {
+      while( ! path.empty() && path.back().second >= path.back().first->size() ) {
+        path.pop_back();
+        if( path.empty() ) return;
+        path.back().second++;
+        if( path.back().second < path.back().first->size() ) descend();
+      }
+    }
+
+    std::vector< std::pair<node const*, size_t> > path;
+  };
+
+
+  //A Version of the Map
+  struct version {
+
+    version() : root{ new node } { }
+
+    V0 const* find( K0 const& key ) const {
+      return atomic_ordered_map::find( root.get(), key );
+    }
+
+    void insert_or_assign( K0 const& key, V0 value ) {
+      if( atomic_ordered_map::insert( root, key, value ) ) length++;
+      //grow at the root
+      if( root->size() > B0 ) {
+        node_ref root_new{ new node };
+        root_new->leaf = false;
+        root_new->children.push_back( (node_ref&&) root );
+        split_child( root_new.get(), 0 );
+        root = (node_ref&&) root_new;
+      }
+    }
+
+    bool erase( K0 const& key ) {
+      if( ! find( key ) ) return false;
+      atomic_ordered_map::erase( root, key );
+      length--;
+      //shrink at the root
+      while( ! root->leaf && root->children.size() == 1 ) {
+        node_ref child = root->children[ 0 ];
+        root = (node_ref&&) child;
+      }
+      if( ! root->leaf && root->children.empty() ) root = node_ref{ new node };
+      return true;
+    }
+
+    iterator begin() const {
+      iterator it;
+      it.path.push_back( { root.get(), 0 } );
+      it.descend();
+      it.normalize();
+      return it;
+    }
+
+    iterator end() const { return { }; }
+
+    //the first entry with a key not less than key
+    iterator lower_bound( K0 const& key ) const {
+      iterator it;
+      node const* node0 = root.get();
+      while( ! node0->leaf ) {
+        size_t i = child_index( node0, key );
+        it.path.push_back( { node0, i } );
+        node0 = node0->children[ i ].get();
+      }
+      it.path.push_back( { node0, key_index( node0, key ) } );
+      it.normalize();
+      return it;
+    }
+
+    template< typename U0 >
+    void for_each( K0 const& first, K0 const& last, U0 fn ) const {
+      for( auto it = lower_bound( first ), it_end = end(); it != it_end; ++it ) {
+        auto entry = *it;
+        if( ! C0{ }( entry.first, last ) ) break;
+        fn( entry.first, entry.second );
+      }
+    }
+
+    size_t size() const { return length; }
+
+    node_ref root;
+    size_t length = 0;
+  };
+
+
+  template< typename U0 >
+  auto read( U0 fn ) const -> decltype( fn( ( version* ) nullptr ) ) {
+    return data.read( fn );
+  }
+
+  template< typename U0 >
+  auto update( U0 fn ) -> decltype( fn( ( version* ) nullptr ), (void) 0 ) {
+    data.update( fn );
+  }
+
+  template< typename U0 >
+  bool update_weak( U0 fn ) {
+    return data.update_weak( fn );
+  }
+
+  version snapshot() const {
+    return data.read( []( version* version0 ) { return *version0; } );
+  }
+
+  void insert_or_assign( K0 const& key, V0 value ) {
+    data.update( [ &key, &value ]( version* version0 ) {
+      version0->insert_or_assign( key, value );
+      return true;
+    } );
+  }
+
+  //a missing key doesn't publish a version
+  bool erase( K0 const& key ) {
+    bool r = false, missing = false;
+    while( ! data.update_weak( [ &key, &r, &missing ]( version* version0 ) {
+      r = version0->erase( key );
+      missing = ! r;
+      return r;
+    } ) && ! missing );
+    return r;
+  }
+
+  bool find( K0 const& key, V0& value ) const {
+    return data.read( [ &key, &value ]( version* version0 ) {
+      V0 const* value0 = version0->find( key );
+      if( value0 ) value = *value0;
+      return value0 != nullptr;
+    } );
+  }
+
+  size_t size() const {
+    return data.read( []( version* version0 ) { return version0->size(); } );
+  }
+
+  atomic_data<version, N0> data;
+};
+
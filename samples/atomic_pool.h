@@ -0,0 +1,169 @@
+#pragma once
+
+/*
+
+A node pool for the linked structures built on atomic_data.
+
+Every node of atomic_list is an atomic_data< node > plus the node data it points to, two heap
+allocations per insert and two frees per erase. atomic_pool serves them from slabs:
+a thread takes and returns blocks through its own cache without synchronization,
+caches exchange batches of blocks with a global depot (a mutex, once per batch).
+
+A block is returned to the pool when the last reference to its node is gone, so it's
+already unreachable. The memory is never given back to the system and a block is only
+ever reused for the same type (type-stable memory): a stale pointer to a freed node still
+points to a node of that type. The free list link is kept after the object, so the bytes of
+a freed object (its reference count, for example) stay intact until the block is reused.
+
+API:
+
+types:
+
+  - atomic_pool< data_type >
+  a pool per data type, use a distinct data type for a separate pool
+
+methods:
+
+  - static void* allocate()
+  - static void deallocate( void* )
+  a block for one data_type object
+
+usage:
+
+  struct node {
+    static void* operator new( std::size_t ) { return atomic_pool< node >::allocate(); }
+    static void operator delete( void* object ) { atomic_pool< node >::deallocate( object ); }
+  };
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstddef>
+#include <vector>
+#include <mutex>
+
+
+template< typename T0 >
+struct atomic_pool {
+
+  using uint = unsigned;
+  using size_t = std::size_t;
+
+  static const uint batch_size = 64;
+  static const uint slab_size = 256;
+
+  struct block {
+    alignas( T0 ) char data[ sizeof( T0 ) ];
+    block* next;
+  };
+
+  //a linked list of free blocks
+  struct chain {
+    block* head;
+    uint size;
+  };
+
+  //global depot: batches of free blocks and the slabs
+  struct depot_t {
+    std::mutex lock;
+    std::vector<chain> batches;
+    std::vector<block*> slabs;
+  };
+
+  //thread cache, trivially destructible: stays usable during the destruction of other thread_local
+  //and static objects of the thread
+  struct cache_t {
+    chain free{ nullptr, 0 };
+    bool dead{ false };
+  };
+
+  //returns the blocks of the thread cache to the depot on thread exit and marks the cache dead,
+  //blocks freed by the thread_local destructors that run later go straight to the depot
+  struct cache_exit {
+    ~cache_exit() {
+      cache_t& cache = local();
+      if( cache.free.size ) depot_push( cache.free );
+      cache.free = { nullptr, 0 };
+      cache.dead = true;
+    }
+  };
+
+  static void* allocate() {
+    cache_t& cache = local();
+    if( ! cache.free.head ) refill( cache );
+    block* block0 = cache.free.head;
+    cache.free.head = block0->next;
+    cache.free.size--;
+    if( cache.dead && cache.free.size ) {
+      depot_push( cache.free );
+      cache.free = { nullptr, 0 };
+    }
+    return block0->data;
+  }
+
+  static void deallocate( void* object ) {
+    if( ! object ) return;
+    cache_t& cache = local();
+    block* block0 = (block*) object;
+    if( cache.dead ) {
+      block0->next = nullptr;
+      depot_push( { block0, 1 } );
+      return;
+    }
+    block0->next = cache.free.head;
+    cache.free = { block0, cache.free.size + 1 };
+    //keep a batch for the next allocations, hand the other one over
+    if( cache.free.size >= batch_size * 2 ) {
+      chain batch{ cache.free.head, batch_size };
+      block* last = cache.free.head;
+      for( uint i = 1; i < batch_size; i++ ) last = last->next;
+      cache.free = { last->next, cache.free.size - batch_size };
+      last->next = nullptr;
+      depot_push( batch );
+    }
+  }
+
+  static void refill( cache_t& cache ) {
+
+    depot_t& depot0 = depot();
+    std::lock_guard<std::mutex> lock_guard{ depot0.lock };
+
+    if( ! depot0.batches.empty() ) {
+      cache.free = depot0.batches.back();
+      depot0.batches.pop_back();
+      return;
+    }
+
+    block* slab = new block[ slab_size ];
+    depot0.slabs.push_back( slab );
+    for( uint i = 0; i < slab_size - 1; i++ ) slab[ i ].next = &slab[ i + 1 ];
+    slab[ slab_size - 1 ].next = nullptr;
+    cache.free = { slab, slab_size };
+  }
+
+  static void depot_push( chain batch ) {
+    depot_t& depot0 = depot();
+    std::lock_guard<std::mutex> lock_guard{ depot0.lock };
+    depot0.batches.push_back( batch );
+  }
+
+  //never destroyed: nodes can be freed by static destructors in any order
+  static depot_t& depot() {
+    static depot_t& depot0 = *new depot_t;
+    return depot0;
+  }
+
+  static cache_t& local() {
+    thread_local cache_t cache;
+    thread_local cache_exit exit0;
+    (void) exit0;
+    return cache;
+  }
+
+};
+
@@ -0,0 +1,133 @@
+/*
+
+atomic_queue against atomic_queue_mutex (a std::deque under a mutex) as a channel between
+pipeline stages.
+
+Producers push their values one by one or in batches with push_n, consumers pop with pop_n
+until they get a stop value (0) and sum what they got. The main thread pushes a stop value per
+consumer after the producers are done. The sums must match.
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include "atomic_queue.h"
+#include "atomic_queue_mutex.h"
+
+namespace {
+
+  using uint = unsigned;
+
+  //edit to change the test setup
+  const uint capacity = 1024;
+  const uint items = 1 << 20;
+  const uint threads_sizes[] = { 1, 2, 4 };
+  const uint batch_sizes[] = { 1, 32 };
+  const uint threads_max = 4;
+  const uint batch_max = 32;
+
+  using atomic_queue_t = atomic_queue<uint, capacity>;
+  using atomic_queue_mutex_t = atomic_queue_mutex<uint, capacity>;
+
+}
+
+template< typename T > uint test_queue( uint threads_size, uint batch_size, bool& passed );
+
+int main() {
+
+  printf( "Test parameters:\n\tCPU: %d core(s)\n\tcapacity: %d\n\titems: %d\n\n",
+    std::thread::hardware_concurrency(), capacity, items );
+
+  printf( "time in microseconds, producers = consumers = threads\n" );
+  printf( "%10s %8s %20s %14s\n", "threads", "batch", "atomic_queue_mutex", "atomic_queue" );
+
+  bool passed = true;
+
+  for( uint threads_size : threads_sizes ) {
+    for( uint batch_size : batch_sizes ) {
+      uint time_mutex = test_queue<atomic_queue_mutex_t>( threads_size, batch_size, passed );
+      uint time_queue = test_queue<atomic_queue_t>( threads_size, batch_size, passed );
+      printf( "%10u %8u %20u %14u\n", threads_size, batch_size, time_mutex, time_queue );
+    }
+  }
+
+  printf( "\ntest: %s\n", passed ? "Passed!" : "failed!" );
+
+  printf( "\ndone\n" );
+}
+
+//test function
+template< typename T >
+uint test_queue( uint threads_size, uint batch_size, bool& passed ) {
+
+  T* queue0 = new T{};
+
+  uint items_per_thread = items / threads_size;
+
+  auto produce = [ queue0, items_per_thread, batch_size ]( uint thread ) {
+    uint values[ batch_max ];
+    uint first = thread * items_per_thread + 1;
+    for( uint i = 0; i < items_per_thread; i += batch_size ) {
+      uint size = items_per_thread - i < batch_size ? items_per_thread - i : batch_size;
+      for( uint j = 0; j < size; j++ ) values[ j ] = first + i + j;
+      queue0->push_n( values, size );
+    }
+  };
+
+  std::atomic<unsigned long long> sum{ 0 };
+
+  //the stop values taken from other consumers are pushed back
+  auto consume = [ queue0, batch_size, &sum ]() {
+    uint values[ batch_max ];
+    unsigned long long sum0 = 0;
+    uint stops = 0;
+    while( ! stops ) {
+      uint size = (uint) queue0->pop_n( values, batch_size );
+      for( uint j = 0; j < size; j++ ) {
+        if( values[ j ] == 0 ) stops++;
+        sum0 += values[ j ];
+      }
+    }
+    for( ; stops > 1; stops-- ) queue0->push( 0 );
+    sum.fetch_add( sum0 );
+  };
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  std::thread producers[ threads_max ];
+  std::thread consumers[ threads_max ];
+
+  for( uint i = 0; i < threads_size; i++ ) {
+    producers[ i ] = std::thread{ produce, i };
+    consumers[ i ] = std::thread{ consume };
+  }
+
+  for( uint i = 0; i < threads_size; i++ ) producers[ i ].join();
+  for( uint i = 0; i < threads_size; i++ ) queue0->push( 0 );
+  for( uint i = 0; i < threads_size; i++ ) consumers[ i ].join();
+
+  uint time = (uint) std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+
+  unsigned long long total = (unsigned long long) items_per_thread * threads_size;
+  unsigned long long expected = total * ( total + 1 ) / 2;
+
+  if( sum.load() != expected || ! queue0->empty() ) {
+    printf( "failed! sum = %llu, expected %llu\n", sum.load(), expected );
+    passed = false;
+  }
+
+  delete queue0;
+
+  return time;
+}
+
@@ -0,0 +1,244 @@
+#pragma once
+
+/*
+
+A bounded lock-free multi-producer multi-consumer FIFO queue (D. Vyukov's bounded queue) with the
+ring of atomic_data: two ever increasing positions, left (the next pop) and right (the next push),
+and an array of a power of two size indexed by position % array_size.
+
+Unlike the queue of atomic_data there is no sync barrier: every cell has a sequence number that
+tells for which position it's ready. A cell is free for the push at position pos when its sequence
+is pos, it's full for the pop at pos when the sequence is pos + 1, the pop sets it to
+pos + array_size (free for the push on the next lap). A position is taken with a CAS of an end, a
+batch takes several consecutive positions with one CAS (the cells are checked before it), so
+producers and consumers touch their end once per batch.
+
+The ends are padded to a cache line: producers and consumers don't share the lines of their
+counters. A push never waits for consumers and a pop never waits for producers, except the wait
+methods: they spin a little, then sleep on a condition variable, a waker only takes the mutex when
+there are sleepers.
+
+API:
+
+create instance:
+
+  - atomic_queue< data_type, capacity = 1024 >
+  capacity is a power of two, data_type must be default constructible and movable
+
+methods:
+
+  - bool try_push( data_type value )
+  - bool try_pop( data_type& value )
+  fail if the queue is full (empty)
+
+  - size_t try_push_n( data_type* values, size_t n )
+  - size_t try_pop_n( data_type* values, size_t n )
+  move up to n elements with a single CAS of an end, return the number of elements
+
+  - void push( data_type value )
+  - data_type pop()
+  - void push_n( data_type* values, size_t n )
+  - size_t pop_n( data_type* values, size_t n )
+  wait while the queue is full (empty), pop_n returns as soon as it got at least one element
+
+  - size_t size(), bool empty()
+  approximate while there are updates in flight
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstddef>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+
+template< typename T0, unsigned N0 = 1024 >
+struct atomic_queue {
+
+  static_assert( N0 >= 2 && ( N0 & ( N0 - 1 ) ) == 0, "capacity of the atomic_queue must be a power of two" );
+
+  using uint = unsigned;
+  using size_t = std::size_t;
+
+  static const size_t cache_line = 64;
+  static const uint array_size = N0;
+
+  //tries before a waiting method goes to sleep
+  static const uint spin_count = 16;
+
+  struct cell {
+    std::atomic<uint> sequence;
+    T0 data;
+  };
+
+  //padded, so the two ends are never in the same cache line
+  struct end {
+    std::atomic<uint> pos{ 0 };
+    char pad[ cache_line - sizeof( std::atomic<uint> ) ];
+  };
+
+  //sleepers are counted, the mutex is only taken by a waker when there are some
+  struct waiter {
+
+    //a waker either sees the count or its cells are seen by ready()
+    template< typename U0 >
+    void wait( U0 ready ) {
+      count.fetch_add( 1, std::memory_order_relaxed );
+      std::atomic_thread_fence( std::memory_order_seq_cst );
+      {
+        std::unique_lock<std::mutex> lock_guard{ lock };
+        while( ! ready() ) signal.wait( lock_guard );
+      }
+      count.fetch_sub( 1, std::memory_order_relaxed );
+    }
+
+    //the fence orders the stores of the cells before the load of the count (see wait)
+    void wake() {
+      std::atomic_thread_fence( std::memory_order_seq_cst );
+      if( count.load( std::memory_order_relaxed ) == 0 ) return;
+      std::lock_guard<std::mutex> lock_guard{ lock };
+      signal.notify_all();
+    }
+
+    std::atomic<uint> count{ 0 };
+    std::mutex lock;
+    std::condition_variable signal;
+  };
+
+  atomic_queue() {
+    for( uint i = 0; i < array_size; i++ ) cells[ i ].sequence.store( i, std::memory_order_relaxed );
+  }
+
+  atomic_queue( atomic_queue const& ) = delete;
+  atomic_queue& operator=( atomic_queue const& ) = delete;
+
+  bool try_push( T0 value ) {
+    return try_push_n( &value, 1 ) == 1;
+  }
+
+  bool try_pop( T0& value ) {
+    return try_pop_n( &value, 1 ) == 1;
+  }
+
+  size_t try_push_n( T0* values, size_t n ) {
+    size_t count = transfer( right, 0, n, [ values ]( cell& cell0, size_t i ) { cell0.data = (T0&&) values[ i ]; } );
+    if( count ) not_empty.wake();
+    return count;
+  }
+
+  size_t try_pop_n( T0* values, size_t n ) {
+    size_t count = transfer( left, 1, n, [ values ]( cell& cell0, size_t i ) { values[ i ] = (T0&&) cell0.data; } );
+    if( count ) not_full.wake();
+    return count;
+  }
+
+  void push( T0 value ) {
+    push_n( &value, 1 );
+  }
+
+  T0 pop() {
+    T0 value;
+    pop_n( &value, 1 );
+    return value;
+  }
+
+  void push_n( T0* values, size_t n ) {
+    for( size_t done = 0; done < n; ) {
+      done += try_push_n( values + done, n - done );
+      if( done < n ) wait( not_full, right, 0 );
+    }
+  }
+
+  size_t pop_n( T0* values, size_t n ) {
+    while( true ) {
+      size_t count = try_pop_n( values, n );
+      if( count ) return count;
+      wait( not_empty, left, 1 );
+    }
+  }
+
+  size_t size() const {
+    uint left0 = left.pos.load( std::memory_order_relaxed );
+    uint right0 = right.pos.load( std::memory_order_relaxed );
+    int size0 = (int) ( right0 - left0 );
+    return size0 < 0 ? 0 : size0 > (int) array_size ? array_size : (size_t) size0;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  //Transfer
+  //takes up to n consecutive positions of an end with one CAS, a cell is ready for the position pos
+  //when its sequence is pos + ready (0 for a push, 1 for a pop), then moves the data and hands the
+  //cells over to the other side: a pushed cell is ready for the pop at pos, a popped one for the
+  //push at pos + array_size
+  template< typename U0 >
+  size_t transfer( end& end0, uint ready, size_t n, U0 move ) {
+
+    uint pos = end0.pos.load( std::memory_order_relaxed );
+
+    while( true ) {
+
+      size_t count = 0;
+      int diff = 0;
+      for( ; count < n && count < array_size; count++ ) {
+        uint sequence = cells[ ( pos + count ) % array_size ].sequence.load( std::memory_order_acquire );
+        diff = (int) ( sequence - ( pos + (uint) count + ready ) );
+        if( diff != 0 ) break;
+      }
+
+      if( count == 0 ) {
+        //full (empty) or the other side is still on the cell
+        if( diff < 0 ) return 0;
+        //the end has moved on
+        pos = end0.pos.load( std::memory_order_relaxed );
+        continue;
+      }
+
+      if( end0.pos.compare_exchange_weak( pos, pos + (uint) count, std::memory_order_relaxed ) ) {
+        for( size_t i = 0; i < count; i++ ) {
+          cell& cell0 = cells[ ( pos + i ) % array_size ];
+          move( cell0, i );
+          cell0.sequence.store( pos + (uint) i + ( ready ? array_size : 1 ), std::memory_order_release );
+        }
+        return count;
+      }
+    }
+  }
+
+  //spins (yielding) while the other side might be about to make room, then sleeps
+  void wait( waiter& waiter0, end& end0, uint ready ) {
+
+    auto is_ready = [ this, &end0, ready ]() {
+      uint pos = end0.pos.load( std::memory_order_relaxed );
+      uint sequence = cells[ pos % array_size ].sequence.load( std::memory_order_acquire );
+      return (int) ( sequence - ( pos + ready ) ) >= 0;
+    };
+
+    for( uint i = 0; i < spin_count; i++ ) {
+      if( is_ready() ) return;
+      std::this_thread::yield();
+    }
+
+    waiter0.wait( is_ready );
+  }
+
+  char pad[ cache_line ];
+
+  end left;
+  end right;
+
+  cell cells[ array_size ];
+
+  waiter not_empty;
+  waiter not_full;
+
+};
+
+
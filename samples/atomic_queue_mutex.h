@@ -0,0 +1,108 @@
+#pragma once
+
+/*
+This is just a version of atomic_queue using a mutex and a std::deque for testing purposes.
+
+More is in the blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+License: Public-domain Software.
+
+*/
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+
+template< typename T0, unsigned N0 = 1024 >
+struct atomic_queue_mutex {
+
+  using size_t = std::size_t;
+
+  atomic_queue_mutex() { }
+  atomic_queue_mutex( atomic_queue_mutex const& ) = delete;
+  atomic_queue_mutex& operator=( atomic_queue_mutex const& ) = delete;
+
+  bool try_push( T0 value ) {
+    return try_push_n( &value, 1 ) == 1;
+  }
+
+  bool try_pop( T0& value ) {
+    return try_pop_n( &value, 1 ) == 1;
+  }
+
+  size_t try_push_n( T0* values, size_t n ) {
+    size_t count = 0;
+    {
+      std::lock_guard<std::mutex> lock_guard{ lock };
+      for( ; count < n && data.size() < N0; count++ ) data.push_back( (T0&&) values[ count ] );
+    }
+    if( count ) not_empty.notify_all();
+    return count;
+  }
+
+  size_t try_pop_n( T0* values, size_t n ) {
+    size_t count = 0;
+    {
+      std::lock_guard<std::mutex> lock_guard{ lock };
+      for( ; count < n && ! data.empty(); count++ ) {
+        values[ count ] = (T0&&) data.front();
+        data.pop_front();
+      }
+    }
+    if( count ) not_full.notify_all();
+    return count;
+  }
+
+  void push( T0 value ) {
+    push_n( &value, 1 );
+  }
+
+  T0 pop() {
+    T0 value;
+    pop_n( &value, 1 );
+    return value;
+  }
+
+  void push_n( T0* values, size_t n ) {
+    for( size_t done = 0; done < n; ) {
+      {
+        std::unique_lock<std::mutex> lock_guard{ lock };
+        while( data.size() == N0 ) not_full.wait( lock_guard );
+        for( ; done < n && data.size() < N0; done++ ) data.push_back( (T0&&) values[ done ] );
+      }
+      not_empty.notify_all();
+    }
+  }
+
+  size_t pop_n( T0* values, size_t n ) {
+    size_t count = 0;
+    {
+      std::unique_lock<std::mutex> lock_guard{ lock };
+      while( data.empty() ) not_empty.wait( lock_guard );
+      for( ; count < n && ! data.empty(); count++ ) {
+        values[ count ] = (T0&&) data.front();
+        data.pop_front();
+      }
+    }
+    not_full.notify_all();
+    return count;
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock_guard{ lock };
+    return data.size();
+  }
+
+  bool empty() const { return size() == 0; }
+
+  std::deque<T0> data;
+
+  mutable std::mutex lock;
+  std::condition_variable not_empty;
+  std::condition_variable not_full;
+
+};
+
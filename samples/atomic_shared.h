@@ -0,0 +1,281 @@
+#pragma once
+
+/*
+
+Intrusive reference counting for the persistent data structures built on atomic_data.
+
+atomic_data copies the data type on every update. Data types that hold big parts by a
+shared_ref only copy the references: an update makes a new version that shares all
+untouched parts with the previous versions still in the queue. A part is freed when
+the last version referencing it is gone.
+
+The count lives in the object itself (derive from shared_base), so there is a single
+allocation per object and copying a reference is one relaxed atomic increment.
+
+API:
+
+types:
+
+  - shared_base
+  base for reference counted objects, a new object has the count of 1
+
+  - shared_ref< T >
+  an owning reference to T derived from shared_base
+
+  - tagged_ref< T, bits = 2 >
+  an owning reference in one word with bits flags in the low bits of the pointer (T must be
+  aligned to at least 2^bits), copying copies the flags, assigning a shared_ref keeps them
+
+methods of shared_ref:
+
+  - shared_ref( T* object )
+  adopts a newly created object (doesn't increment the count)
+
+  - static shared_ref share( T* object )
+  takes one more reference to an object that is kept alive by other references
+
+  - static shared_ref try_share( T* object )
+  takes a reference only if the count is not zero yet (empty otherwise), for objects from
+  type-stable memory (atomic_pool) read from a shared link: then check the link still points to it
+  the object might be freed and its memory reused for a new object of the same type during the
+  call: the memory must never go back to the system or to another type, and the count is set with
+  an atomic store when an object is constructed (a try_share on the memory reads a count, 0 or 1,
+  and a reference taken on a new object is valid, the link check drops it)
+
+  - T* get(), operator->, operator*, operator bool
+  access
+
+  - bool unique()
+  true if this is the only reference, then the object can be modified in place
+
+  - void reset( T* object = nullptr )
+  drops the reference and adopts a new object
+
+  - T* detach()
+  gives up the reference without dropping the count
+
+methods of tagged_ref:
+
+  - tagged_ref( shared_ref< T > ), operator=( shared_ref< T > )
+  adopts the reference, the assignment keeps the flags
+
+  - T* get(), operator->, operator bool, void reset(), T* detach()
+  like shared_ref, reset and detach keep the flags
+
+  - shared_ref< T > ref()
+  a new reference to the object
+
+  - bool tag( unsigned bit ), void set_tag( unsigned bit, bool value )
+  the flags
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <atomic>
+#include <cstdint>
+
+
+struct shared_base {
+
+  using uint = unsigned;
+
+  //the count is stored atomically, not initialized: a try_share on recycled memory might read it
+  //while the object is constructed
+  shared_base() { refs.store( 1, std::memory_order_relaxed ); }
+
+  //the count is not copied with the object
+  shared_base( shared_base const& ) { refs.store( 1, std::memory_order_relaxed ); }
+  shared_base& operator=( shared_base const& ) { return *this; }
+
+  uint use_count() const { return refs.load( std::memory_order_acquire ); }
+
+  mutable std::atomic<uint> refs;
+};
+
+
+template< typename T0 >
+struct shared_ref {
+
+  using uint = unsigned;
+
+  shared_ref() { }
+
+  explicit shared_ref( T0* object ) : ptr{ object } { }
+
+  shared_ref( shared_ref const& r ) : ptr{ r.ptr } {
+    acquire();
+  }
+
+  shared_ref( shared_ref&& r ) noexcept : ptr{ r.ptr } {
+    r.ptr = nullptr;
+  }
+
+  //the object must be alive (referenced elsewhere) for the duration of the call
+  static shared_ref share( T0* object ) {
+    shared_ref r{ object };
+    r.acquire();
+    return r;
+  }
+
+  //the object might be freed meanwhile: the memory must stay an object of the same type (type-stable
+  //memory, see atomic_pool.h), the count of a new object on it is stored atomically (shared_base)
+  static shared_ref try_share( T0* object ) {
+    uint refs0 = object->refs.load( std::memory_order_relaxed );
+    while( refs0 && ! object->refs.compare_exchange_weak( refs0, refs0 + 1, std::memory_order_acquire, std::memory_order_relaxed ) );
+    return refs0 ? shared_ref{ object } : shared_ref{ };
+  }
+
+  shared_ref& operator=( shared_ref const& r ) {
+    if( ptr != r.ptr ) {
+      r.acquire();
+      release();
+      ptr = r.ptr;
+    }
+    return *this;
+  }
+
+  shared_ref& operator=( shared_ref&& r ) noexcept {
+    if( this != &r ) {
+      release();
+      ptr = r.ptr;
+      r.ptr = nullptr;
+    }
+    return *this;
+  }
+
+  ~shared_ref() {
+    release();
+  }
+
+  void reset( T0* object = nullptr ) {
+    release();
+    ptr = object;
+  }
+
+  T0* detach() {
+    T0* object = ptr;
+    ptr = nullptr;
+    return object;
+  }
+
+  T0* get() const { return ptr; }
+  T0* operator->() const { return ptr; }
+  T0& operator*() const { return *ptr; }
+  explicit operator bool() const { return ptr != nullptr; }
+
+  bool unique() const { return ptr && ptr->refs.load( std::memory_order_acquire ) == 1; }
+
+  bool operator==( shared_ref const& r ) const { return ptr == r.ptr; }
+  bool operator!=( shared_ref const& r ) const { return ptr != r.ptr; }
+
+private:
+
+  void acquire() const {
+    if( ptr ) ptr->refs.fetch_add( 1, std::memory_order_relaxed );
+  }
+
+  //acq_rel: all the writes to the object happen before its deletion
+  void release() {
+    if( ptr && ptr->refs.fetch_sub( 1, std::memory_order_acq_rel ) == 1 ) delete ptr;
+    ptr = nullptr;
+  }
+
+  T0* ptr = nullptr;
+};
+
+
+template< typename T0, unsigned B0 = 2 >
+struct tagged_ref {
+
+  static_assert( alignof( T0 ) >= ( 1u << B0 ), "tagged_ref: the type is not aligned enough for the flags" );
+
+  using uint = unsigned;
+  using uintptr_t = std::uintptr_t;
+
+  static const uintptr_t mask = ( uintptr_t{ 1 } << B0 ) - 1;
+
+  tagged_ref() { }
+
+  tagged_ref( shared_ref<T0> r ) : bits{ (uintptr_t) r.detach() } { }
+
+  tagged_ref( tagged_ref const& r ) : bits{ r.bits } {
+    acquire();
+  }
+
+  tagged_ref( tagged_ref&& r ) noexcept : bits{ r.bits } {
+    r.bits = 0;
+  }
+
+  tagged_ref& operator=( tagged_ref const& r ) {
+    if( bits != r.bits ) {
+      r.acquire();
+      release();
+      bits = r.bits;
+    }
+    return *this;
+  }
+
+  tagged_ref& operator=( tagged_ref&& r ) noexcept {
+    if( this != &r ) {
+      release();
+      bits = r.bits;
+      r.bits = 0;
+    }
+    return *this;
+  }
+
+  //replaces the reference, the flags stay
+  tagged_ref& operator=( shared_ref<T0> r ) {
+    release();
+    bits |= (uintptr_t) r.detach();
+    return *this;
+  }
+
+  ~tagged_ref() {
+    release();
+  }
+
+  void reset() {
+    release();
+  }
+
+  T0* detach() {
+    T0* object = get();
+    bits &= mask;
+    return object;
+  }
+
+  T0* get() const { return (T0*) ( bits & ~mask ); }
+  T0* operator->() const { return get(); }
+  explicit operator bool() const { return get() != nullptr; }
+
+  shared_ref<T0> ref() const { return shared_ref<T0>::share( get() ); }
+
+  bool tag( uint bit ) const { return ( bits >> bit ) & 1; }
+
+  void set_tag( uint bit, bool value ) {
+    if( value ) bits |= uintptr_t{ 1 } << bit;
+    else bits &= ~( uintptr_t{ 1 } << bit );
+  }
+
+private:
+
+  void acquire() const {
+    if( T0* object = get() ) object->refs.fetch_add( 1, std::memory_order_relaxed );
+  }
+
+  //drops the reference, the flags stay
+  void release() {
+    T0* object = get();
+    bits &= mask;
+    if( object && object->refs.fetch_sub( 1, std::memory_order_acq_rel ) == 1 ) delete object;
+  }
+
+  uintptr_t bits = 0;
+};
+
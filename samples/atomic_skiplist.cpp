@@ -0,0 +1,162 @@
+/*
+
+atomic_skiplist against atomic_data_mutex< std::map > with 16 to 64 threads.
+
+The maps are filled with size keys, then every thread runs a mix of finds, inserts and erases
+of random keys (find_percent of finds, the rest is split between inserts and erases).
+Threads count the keys they have added and erased: at the end the size of the map must match,
+and the keys of the skip list must be in order.
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <map>
+
+#include "atomic_data_mutex.h"
+#include "atomic_skiplist.h"
+
+namespace {
+
+  using uint = unsigned;
+
+  //edit to change the test setup
+  const uint size = 100000;
+  const uint iterations = 4096;
+  const uint find_percent = 50;
+  const uint threads_sizes[] = { 16, 32, 64 };
+  const uint threads_max = 64;
+
+  using map = std::map<uint, uint>;
+  using atomic_map_mutex_t = atomic_data_mutex<map>;
+  using atomic_skiplist_t = atomic_skiplist<uint, uint, std::less<uint>, threads_max * 2>;
+
+  volatile uint global_dummy;
+
+  //the same syntax for both map types
+  bool insert( atomic_map_mutex_t& map0, uint key, uint value ) {
+    bool r = false;
+    map0.update( [ key, value, &r ]( map* map1 ) {
+      r = map1->emplace( key, value ).second;
+      if( ! r ) (*map1)[ key ] = value;
+      return true;
+    } );
+    return r;
+  }
+
+  bool insert( atomic_skiplist_t& map0, uint key, uint value ) {
+    return map0.insert_or_assign( key, value );
+  }
+
+  bool erase( atomic_map_mutex_t& map0, uint key ) {
+    bool r = false;
+    map0.update( [ key, &r ]( map* map1 ) {
+      r = map1->erase( key ) > 0;
+      return true;
+    } );
+    return r;
+  }
+
+  bool erase( atomic_skiplist_t& map0, uint key ) {
+    return map0.erase( key );
+  }
+
+  uint find( atomic_map_mutex_t& map0, uint key ) {
+    return map0.read( [ key ]( map* map1 ) {
+      auto it = map1->find( key );
+      return it == map1->end() ? 0 : it->second;
+    } );
+  }
+
+  uint find( atomic_skiplist_t& map0, uint key ) {
+    uint value = 0;
+    map0.find( key, value );
+    return value;
+  }
+
+  bool check( atomic_map_mutex_t& map0, long expected ) {
+    return map0.read( [ expected ]( map* map1 ) { return (long) map1->size() == expected; } );
+  }
+
+  bool check( atomic_skiplist_t& map0, long expected ) {
+    long count = 0;
+    bool ordered = true;
+    uint last = 0;
+    map0.for_each( [ &count, &ordered, &last ]( uint key, uint ) {
+      if( count++ && key <= last ) ordered = false;
+      last = key;
+    } );
+    return ordered && count == expected && (long) map0.size() == expected;
+  }
+
+}
+
+template< typename T > uint test_map( uint threads_size );
+
+int main() {
+
+  printf( "Test parameters:\n\tCPU: %d core(s)\n\tsize: %d\n\toperations/thread: %d\n\tfinds: %d%%\n\n",
+    std::thread::hardware_concurrency(), size, iterations, find_percent );
+
+  printf( "time in microseconds\n" );
+  printf( "%10s %18s %17s\n", "threads", "atomic_map_mutex", "atomic_skiplist" );
+
+  for( uint threads_size : threads_sizes ) {
+    uint time_map_mutex = test_map<atomic_map_mutex_t>( threads_size );
+    uint time_skiplist = test_map<atomic_skiplist_t>( threads_size );
+    printf( "%10u %18u %17u\n", threads_size, time_map_mutex, time_skiplist );
+  }
+
+  printf( "\ndone\n" );
+}
+
+//test function
+template< typename T >
+uint test_map( uint threads_size ) {
+
+  T map0;
+
+  for( uint i = 0; i < size; i++ ) insert( map0, i * 2, i );
+
+  std::atomic<long> count{ size };
+
+  auto run = [ &map0, &count ]() {
+    auto seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    std::mt19937_64 gen0( seed );
+    std::uniform_int_distribution<uint> engine0{ 0, size * 2 - 1 };
+    std::uniform_int_distribution<uint> engine1{ 0, 99 };
+
+    long added = 0;
+
+    for( uint i = 0; i < iterations; i++ ) {
+      uint key = engine0( gen0 );
+      uint op = engine1( gen0 );
+      if( op < find_percent ) global_dummy = find( map0, key );
+      else if( op % 2 == 0 ) added += insert( map0, key, i );
+      else added -= erase( map0, key );
+    }
+
+    count.fetch_add( added );
+  };
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  std::thread threads[ threads_max ];
+  for( uint i = 0; i < threads_size; i++ ) threads[ i ] = std::thread{ run };
+  for( uint i = 0; i < threads_size; i++ ) threads[ i ].join();
+
+  uint time = (uint) std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+
+  if( ! check( map0, count.load() ) ) printf( "failed! size = %ld\n", count.load() );
+
+  return time;
+}
+
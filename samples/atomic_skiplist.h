@@ -0,0 +1,381 @@
+#pragma once
+
+/*
+
+A lock-free skip list (an ordered map) using atomic_data per node, like atomic_list.
+
+Every node is an atomic_data< node > holding the key, the value and the links of all the levels
+of the node: a link of any level is changed by an update of the node, so inserting a node at
+level 0 is a single update of the previous node. A node is erased by marking it (locked, one
+update, all its levels are frozen at once) and then unlinked level by level by the searches
+that meet it (like in Harris' list), a failed unlink is never rolled back.
+
+Searches are borrowed traversals under one read guard (see atomic_list.h): raw pointers are
+followed, only the nodes that are kept get a reference. Find, insert and erase are expected
+O(log n), for_each over a key range walks level 0 from the first key.
+
+API:
+
+create instance:
+
+  - atomic_skiplist< key_type, value_type, compare = std::less< key_type >, queue_size = 8, levels = 20, domain = void >
+  queue_size is passed to atomic_data (2 * number of threads is usually enough), levels is the
+  maximum height of a node (a node gets one more level with the probability of 1/2)
+  nodes come from a node pool (atomic_pool.h), skip lists with different domain types don't share
+  the queue of atomic_data and the pool
+
+methods:
+
+  - bool insert_or_assign( key_type const& key, value_type value )
+  returns true if the key was added
+
+  - bool erase( key_type const& key )
+  returns true if the key was erased by this call
+
+  - bool find( key_type const& key, value_type& value ) const
+  - bool contains( key_type const& key ) const
+
+  - void for_each( F ) const
+  - void for_each( key_type const& first, key_type const& last, F ) const
+  F accepts a key and a value, the second one visits the keys in [first, last)
+  F must not modify the skip list
+
+  - size_t size() const
+  O(1), sharded counter (atomic_counter.h), approximate while there are updates in flight
+
+  - size_t size_exact() const
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "atomic_data.h"
+#include "atomic_shared.h"
+#include "atomic_pool.h"
+#include "atomic_counter.h"
+
+
+template< typename K0, typename V0, typename C0 = std::less<K0>, unsigned N0 = 8, unsigned L0 = 20, typename D0 = void >
+struct atomic_skiplist {
+
+  static_assert( L0 >= 1 && L0 <= 32, "levels for the atomic_skiplist must be from 1 to 32" );
+
+  using size_t = std::size_t;
+  using uint = unsigned;
+
+  struct node;
+  struct atomic_node;
+
+  using node_ptr = shared_ref<atomic_node>;
+  using guard = typename atomic_data<node, N0>::guard;
+
+  //locked is the mark: a marked node is never updated again
+  struct node {
+
+    K0 key;
+    V0 value;
+    uint height = 0;
+    bool locked = false;
+    node_ptr next[ L0 ];
+
+    //only the levels in use are copied, the ones above of a queue element are released
+    friend void atomic_data_copy( node& dst, node const& src ) {
+      dst.key = src.key;
+      dst.value = src.value;
+      dst.locked = src.locked;
+      for( uint i = 0, height = dst.height > src.height ? dst.height : src.height; i < height; i++ ) {
+        if( i < src.height ) dst.next[ i ] = src.next[ i ];
+        else dst.next[ i ].reset();
+      }
+      dst.height = src.height;
+    }
+
+    static void* operator new( std::size_t ) { return atomic_pool<node>::allocate(); }
+    static void operator delete( void* object ) { atomic_pool<node>::deallocate( object ); }
+  };
+
+  struct atomic_node : shared_base, atomic_data<node, N0> {
+
+    atomic_node( node* node0 = new node{ } ) : atomic_data<node, N0>{ node0 } { }
+
+    static void* operator new( std::size_t ) { return atomic_pool<atomic_node>::allocate(); }
+    static void operator delete( void* object ) { atomic_pool<atomic_node>::deallocate( object ); }
+  };
+
+
+  //the head has all the levels and no key
+  atomic_skiplist() : head{ new atomic_node{ new node{ K0{ }, V0{ }, L0, false } } } { }
+
+  //the nodes are released one by one, a long chain of references would recurse
+  ~atomic_skiplist() {
+    node_ptr it = detach( head.get() );
+    while( it ) it = detach( it.get() );
+  }
+
+  //drops all the links of a node, returns the next node at level 0
+  static node_ptr detach( atomic_node* node0 ) {
+    node_ptr next;
+    node0->update( [ &next ]( node* node1 ) {
+      next = node1->next[ 0 ];
+      for( uint i = 0; i < node1->height; i++ ) node1->next[ i ].reset();
+      return true;
+    } );
+    return next;
+  }
+
+
+  //Search
+  //finds the last node before key (preds) and the next one (succs) at every level, skips the marked
+  //nodes (a marked node is frozen, the walk goes on from it), with snip tries to unlink them
+  //(update_weak under the guard fails at the sync barrier, it's best effort)
+  //returns the version of succs[ 0 ] or nullptr
+  node* search( guard const& guard0, K0 const& key, atomic_node** preds, atomic_node** succs, bool snip ) const {
+
+    atomic_node* it = head.get();
+    node* node0 = read( guard0, it );
+    node* node_next = nullptr;
+
+    for( uint level = L0; level-- > 0; ) {
+
+      atomic_node* it_next;
+
+      while( true ) {
+
+        it_next = node0->next[ level ].get();
+
+        while( it_next && ( node_next = read( guard0, it_next ) )->locked ) {
+          if( snip ) unlink( it, it_next, node_next, level );
+          it_next = node_next->next[ level ].get();
+        }
+
+        if( it_next && C0{ }( node_next->key, key ) ) {
+          it = it_next;
+          node0 = node_next;
+          continue;
+        }
+
+        break;
+      }
+
+      preds[ level ] = it;
+      succs[ level ] = it_next;
+      if( ! it_next ) node_next = nullptr;
+    }
+
+    return node_next;
+  }
+
+  static node* read( guard const& guard0, atomic_node* it ) {
+    return it->read( guard0, []( node* node0 ) { return node0; } );
+  }
+
+  //replaces the link of prev to a marked node with the link to the node after it
+  static bool unlink( atomic_node* prev, atomic_node* node_marked, node const* frozen, uint level ) {
+    return prev->update_weak( [ node_marked, frozen, level ]( node* node0 ) {
+      if( node0->locked || node0->next[ level ].get() != node_marked ) return false;
+      node0->next[ level ] = frozen->next[ level ];
+      return true;
+    } );
+  }
+
+  static bool equal( node const* node0, K0 const& key ) {
+    return node0 && ! C0{ }( key, node0->key );
+  }
+
+  static uint random_height() {
+    thread_local std::uint32_t state = (std::uint32_t) (std::uintptr_t) &state | 1;
+    uint height = 1;
+    while( height < L0 ) {
+      state ^= state << 13, state ^= state >> 17, state ^= state << 5;
+      if( state & 1 ) break;
+      height++;
+    }
+    return height;
+  }
+
+
+  bool insert_or_assign( K0 const& key, V0 value ) {
+
+    atomic_node* preds[ L0 ];
+    atomic_node* succs[ L0 ];
+
+    node_ptr node_new;
+    uint height = random_height();
+
+    //level 0: the insertion itself
+    while( true ) {
+
+      guard guard0{ };
+
+      node* node0 = search( guard0, key, preds, succs, true );
+
+      //the key is present: assign
+      if( equal( node0, key ) ) {
+        bool r = succs[ 0 ]->update_weak( [ &value ]( node* node1 ) {
+          if( node1->locked ) return false;
+          node1->value = value;
+          return true;
+        } );
+        if( r ) return false;
+        continue;
+      }
+
+      node* node1 = new node{ key, value, height, false };
+      for( uint i = 0; i < height; i++ ) node1->next[ i ] = node_ptr::share( succs[ i ] );
+      node_new.reset( new atomic_node{ node1 } );
+
+      bool r = preds[ 0 ]->update_weak( [ &node_new, &succs ]( node* node2 ) {
+        if( node2->locked || node2->next[ 0 ].get() != succs[ 0 ] ) return false;
+        node2->next[ 0 ] = node_new;
+        return true;
+      } );
+
+      if( r ) break;
+    }
+
+    counter.add( 1 );
+
+    //the upper levels, stops if the node gets erased meanwhile
+    for( uint level = 1; level < height; ) {
+
+      guard guard0{ };
+
+      search( guard0, key, preds, succs, true );
+
+      node* node0 = read( guard0, node_new.get() );
+
+      if( node0->locked ) break;
+
+      if( succs[ level ] == node_new.get() ) {
+        level++;
+        continue;
+      }
+
+      if( node0->next[ level ].get() != succs[ level ] ) {
+        atomic_node* succ = succs[ level ];
+        node_new->update_weak( [ succ, level ]( node* node1 ) {
+          if( node1->locked ) return false;
+          node1->next[ level ] = node_ptr::share( succ );
+          return true;
+        } );
+        continue;
+      }
+
+      bool r = preds[ level ]->update_weak( [ &node_new, &succs, level ]( node* node1 ) {
+        if( node1->locked || node1->next[ level ].get() != succs[ level ] ) return false;
+        node1->next[ level ] = node_new;
+        return true;
+      } );
+
+      if( r ) level++;
+    }
+
+    return true;
+  }
+
+  bool erase( K0 const& key ) {
+
+    atomic_node* preds[ L0 ];
+    atomic_node* succs[ L0 ];
+
+    while( true ) {
+
+      guard guard0{ };
+
+      node* node0 = search( guard0, key, preds, succs, true );
+
+      if( ! equal( node0, key ) ) return false;
+
+      bool marked = false;
+
+      bool r = succs[ 0 ]->update_weak( [ &marked ]( node* node1 ) {
+        if( node1->locked ) {
+          marked = true;
+          return false;
+        }
+        node1->locked = true;
+        return true;
+      } );
+
+      //erased by someone else
+      if( marked ) return false;
+
+      if( ! r ) continue;
+
+      counter.add( -1 );
+
+      //unlink it from all the levels, the searches that follow finish it if it fails
+      search( guard0, key, preds, succs, true );
+
+      return true;
+    }
+  }
+
+  bool find( K0 const& key, V0& value ) const {
+    atomic_node* preds[ L0 ];
+    atomic_node* succs[ L0 ];
+    guard guard0{ };
+    node* node0 = search( guard0, key, preds, succs, false );
+    if( ! equal( node0, key ) ) return false;
+    value = node0->value;
+    return true;
+  }
+
+  bool contains( K0 const& key ) const {
+    atomic_node* preds[ L0 ];
+    atomic_node* succs[ L0 ];
+    guard guard0{ };
+    return equal( search( guard0, key, preds, succs, false ), key );
+  }
+
+  template< typename U0 >
+  void for_each( U0 fn ) const {
+    guard guard0{ };
+    walk( guard0, read( guard0, head.get() )->next[ 0 ].get(), fn, []( K0 const& ) { return true; } );
+  }
+
+  template< typename U0 >
+  void for_each( K0 const& first, K0 const& last, U0 fn ) const {
+    atomic_node* preds[ L0 ];
+    atomic_node* succs[ L0 ];
+    guard guard0{ };
+    search( guard0, first, preds, succs, false );
+    walk( guard0, succs[ 0 ], fn, [ &last ]( K0 const& key ) { return C0{ }( key, last ); } );
+  }
+
+  //level 0 from it while in_range( key ), marked nodes are skipped
+  template< typename U0, typename U1 >
+  static void walk( guard const& guard0, atomic_node* it, U0& fn, U1 in_range ) {
+    while( it ) {
+      node* node0 = read( guard0, it );
+      if( ! node0->locked ) {
+        if( ! in_range( node0->key ) ) return;
+        fn( (K0 const&) node0->key, (V0 const&) node0->value );
+      }
+      it = node0->next[ 0 ].get();
+    }
+  }
+
+  size_t size() const {
+    return counter.load();
+  }
+
+  size_t size_exact() const {
+    size_t count = 0;
+    for_each( [ &count ]( K0 const&, V0 const& ) { count++; } );
+    return count;
+  }
+
+  node_ptr head;
+
+  sharded_counter<> counter;
+};
+
@@ -0,0 +1,128 @@
+/*
+
+atomic_stack against atomic_list used as a stack (push_front/pop_front) with 16 to 64 threads.
+
+The stacks get stack_size elements, then every thread pushes and pops in turns. Threads sum the
+values they have pushed and popped: at the end the elements left must have the sum of the initial
+ones plus the pushed minus the popped, and the size must be the same.
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstdio>
+#include <thread>
+#include <chrono>
+#include <atomic>
+
+#include "atomic_list.h"
+#include "atomic_stack.h"
+
+namespace {
+
+  using uint = unsigned;
+
+  //edit to change the test setup
+  const uint stack_size = 64;
+  const uint iterations = 32768;
+  const uint threads_sizes[] = { 16, 32, 64 };
+  const uint threads_max = 64;
+
+  using atomic_list_t = atomic_list<uint, threads_max * 2>;
+  using atomic_stack_t = atomic_stack<uint>;
+
+  //the same syntax for both
+  void push( atomic_list_t& stack0, uint value ) { stack0.push_front( value ); }
+  void push( atomic_stack_t& stack0, uint value ) { stack0.push( value ); }
+
+  bool pop( atomic_list_t& stack0, uint& value ) {
+    auto it = stack0.pop_front();
+    if( it ) value = *it;
+    return (bool) it;
+  }
+
+  bool pop( atomic_stack_t& stack0, uint& value ) { return stack0.pop( value ); }
+
+  long long sum( atomic_list_t& stack0 ) {
+    long long sum0 = 0;
+    stack0.for_each( [ &sum0 ]( uint value ) { sum0 += value; } );
+    return sum0;
+  }
+
+  long long sum( atomic_stack_t& stack0 ) {
+    long long sum0 = 0;
+    uint value;
+    while( stack0.pop( value ) ) sum0 += value;
+    return sum0;
+  }
+
+}
+
+template< typename T > uint test_stack( uint threads_size, bool& passed );
+
+int main() {
+
+  printf( "Test parameters:\n\tCPU: %d core(s)\n\tstack size: %d\n\tpush/pop pairs/thread: %d\n\n",
+    std::thread::hardware_concurrency(), stack_size, iterations );
+
+  printf( "time in microseconds\n" );
+  printf( "%10s %14s %14s\n", "threads", "atomic_list", "atomic_stack" );
+
+  bool passed = true;
+
+  for( uint threads_size : threads_sizes ) {
+    uint time_list = test_stack<atomic_list_t>( threads_size, passed );
+    uint time_stack = test_stack<atomic_stack_t>( threads_size, passed );
+    printf( "%10u %14u %14u\n", threads_size, time_list, time_stack );
+  }
+
+  printf( "\ntest: %s\n", passed ? "Passed!" : "failed!" );
+
+  printf( "\ndone\n" );
+}
+
+//test function
+template< typename T >
+uint test_stack( uint threads_size, bool& passed ) {
+
+  T stack0;
+
+  long long expected = 0;
+  for( uint i = 1; i <= stack_size; i++ ) {
+    push( stack0, i );
+    expected += i;
+  }
+
+  std::atomic<long long> balance{ 0 };
+
+  auto run = [ &stack0, &balance ]( uint thread ) {
+    long long balance0 = 0;
+    for( uint i = 0; i < iterations; i++ ) {
+      uint value = thread * iterations + i + 1;
+      push( stack0, value );
+      balance0 += value;
+      if( pop( stack0, value ) ) balance0 -= value;
+    }
+    balance.fetch_add( balance0 );
+  };
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  std::thread threads[ threads_max ];
+  for( uint i = 0; i < threads_size; i++ ) threads[ i ] = std::thread{ run, i };
+  for( uint i = 0; i < threads_size; i++ ) threads[ i ].join();
+
+  uint time = (uint) std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+
+  if( stack0.size() != stack_size || sum( stack0 ) != expected + balance.load() ) {
+    printf( "failed! size = %u\n", (uint) stack0.size() );
+    passed = false;
+  }
+
+  return time;
+}
+
@@ -0,0 +1,206 @@
+#pragma once
+
+/*
+
+A lock-free stack (Treiber's stack) with an elimination array, a LIFO next to atomic_list.
+
+The top of the stack is a single word: push is a CAS of it, pop is a CAS of it from the top node
+to the node below. The top word and every node own a reference to the node they point to (the
+intrusive count of atomic_shared.h), a pop moves the reference of the popped node to the node
+below to the top word. The node is read only under a reference taken with try_share and checked
+to be the top one: a node can't be freed and reused while it's held (no ABA), and the memory of a
+node that was freed meanwhile is still a node (atomic_pool.h), so the count can be checked.
+
+Under contention the head word is the bottleneck: a push or a pop that failed its CAS goes to the
+elimination array (E. Hendler, N. Shavit, L. Yerushalmi). A push offers its node in a random slot
+and waits a little, a pop that finds an offer takes it with a CAS of the slot: the pair never
+touches the head, it's as if the push happened right before the pop. An offer nobody took is
+withdrawn and the push goes back to the head.
+
+API:
+
+create instance:
+
+  - atomic_stack< data_type, domain = void >
+  nodes come from a node pool, stacks with different domain types don't share it
+
+methods:
+
+  - void push( data_type value )
+  - bool pop( data_type& value )
+  pop fails if the stack is empty
+
+  - size_t size()
+  sharded counter (atomic_counter.h), approximate while there are updates in flight
+
+  - bool empty()
+  - void clear()
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+
+#include "atomic_shared.h"
+#include "atomic_pool.h"
+#include "atomic_counter.h"
+
+
+template< typename T0, typename D0 = void >
+struct atomic_stack {
+
+  using uint = unsigned;
+  using size_t = std::size_t;
+
+  static const size_t cache_line = 64;
+
+  //the slots of the elimination array and how long an offer waits in one
+  static const uint elimination_size = 16;
+  static const uint elimination_spins = 64;
+
+  //next is owned by the node while it's in the stack, a popped node doesn't release it
+  struct node : shared_base {
+    T0 data;
+    node* next = nullptr;
+
+    static void* operator new( std::size_t ) { return atomic_pool<node>::allocate(); }
+    static void operator delete( void* object ) { atomic_pool<node>::deallocate( object ); }
+  };
+
+  using node_ptr = shared_ref<node>;
+
+  //padded, so pushes and pops in different slots don't share a cache line
+  struct slot {
+    std::atomic<node*> offer{ nullptr };
+    char pad[ cache_line - sizeof( std::atomic<node*> ) ];
+  };
+
+  atomic_stack() { }
+  atomic_stack( atomic_stack const& ) = delete;
+  atomic_stack& operator=( atomic_stack const& ) = delete;
+
+  ~atomic_stack() {
+    release( head.exchange( nullptr, std::memory_order_acquire ) );
+  }
+
+  void push( T0 value ) {
+
+    node* node0 = new node{ };
+    node0->data = (T0&&) value;
+    node0->next = head.load( std::memory_order_relaxed );
+
+    counter.add( 1 );
+
+    while( ! head.compare_exchange_weak( node0->next, node0, std::memory_order_release, std::memory_order_relaxed ) ) {
+      if( eliminate_push( node0 ) ) return;
+      node0->next = head.load( std::memory_order_relaxed );
+    }
+  }
+
+  bool pop( T0& value ) {
+
+    while( true ) {
+
+      node* top = head.load( std::memory_order_acquire );
+
+      if( ! top ) return false;
+
+      //next is read only after the node is seen on the top again: a reused node might be in a push
+      //top might be freed and reused meanwhile, try_share relies on the nodes being type-stable
+      //(atomic_pool) and on the atomic store of the count in shared_base
+      node_ptr node0 = node_ptr::try_share( top );
+      bool r = node0 && head.load( std::memory_order_acquire ) == top;
+
+      //the reference of the top word moves to the node below, ours and the one of the top word are dropped
+      if( r && head.compare_exchange_weak( top, node0->next, std::memory_order_acquire, std::memory_order_relaxed ) ) {
+        value = (T0&&) node0->data;
+        node_ptr{ node0.get() };
+        counter.add( -1 );
+        return true;
+      }
+
+      if( eliminate_pop( value ) ) {
+        counter.add( -1 );
+        return true;
+      }
+    }
+  }
+
+  size_t size() const {
+    return counter.load();
+  }
+
+  bool empty() const {
+    return ! head.load( std::memory_order_acquire );
+  }
+
+  void clear() {
+    counter.add( - (long) release( head.exchange( nullptr, std::memory_order_acquire ) ) );
+  }
+
+  //Elimination
+  //an offer is a node in a slot, the pop that takes it owns it, a push takes back an offer it waited
+  //for too long, so it's taken exactly once (the node is still released by its count: a stale
+  //try_share of a pop might hold it)
+  //the push holds a reference to its node until it has seen the result: the node taken by a pop
+  //can't be freed and offered again in the same slot by another push (the address in the slot
+  //would be the same, and the push would withdraw an offer that isn't its own)
+  bool eliminate_push( node* node0 ) {
+    slot& slot0 = slots[ random() % elimination_size ];
+    node_ptr hold = node_ptr::share( node0 );
+    node* empty = nullptr;
+    if( ! slot0.offer.compare_exchange_strong( empty, node0, std::memory_order_release, std::memory_order_relaxed ) ) return false;
+    for( uint i = 0; i < elimination_spins; i++ ) {
+      if( slot0.offer.load( std::memory_order_relaxed ) != node0 ) return true;
+    }
+    node* offer = node0;
+    return ! slot0.offer.compare_exchange_strong( offer, nullptr, std::memory_order_relaxed );
+  }
+
+  bool eliminate_pop( T0& value ) {
+    slot& slot0 = slots[ random() % elimination_size ];
+    node* offer = slot0.offer.load( std::memory_order_acquire );
+    if( ! offer || ! slot0.offer.compare_exchange_strong( offer, nullptr, std::memory_order_acquire, std::memory_order_relaxed ) ) return false;
+    value = (T0&&) offer->data;
+    node_ptr{ offer };
+    return true;
+  }
+
+  //xorshift per thread
+  static uint random() {
+    thread_local uint state = (uint) (std::uintptr_t) &state | 1;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  //drops a detached chain, returns the number of nodes
+  static size_t release( node* it ) {
+    size_t count = 0;
+    while( it ) {
+      node* next = it->next;
+      node_ptr{ it };
+      it = next;
+      count++;
+    }
+    return count;
+  }
+
+  //owns a reference to the top node
+  std::atomic<node*> head{ nullptr };
+
+  slot slots[ elimination_size ];
+
+  sharded_counter<> counter;
+
+};
+
+
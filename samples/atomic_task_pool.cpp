@@ -0,0 +1,174 @@
+/*
+
+The work-stealing deque and the task pool.
+
+First the owner of a deque pushes and pops values while thieves steal them, the array starts
+small and grows: every value must be taken exactly once (the sums and the counts match).
+
+Then the cost of a task: small tasks submitted to the pool against a std::thread per task,
+and the scaling of parallel_for from 1 to all cores (a sum over an array in chunks, the result
+must be the same for every pool size).
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include "atomic_deque.h"
+#include "atomic_task_pool.h"
+
+namespace {
+
+  using uint = unsigned;
+
+  //edit to change the test setup
+  const uint deque_values = 1 << 20;
+  const uint deque_capacity = 16;
+  const uint thieves_size = 3;
+  const uint tasks_size = 100000;
+  const uint threads_tasks_size = 1000;
+  const uint array_size = 1 << 24;
+  const uint grain = 1 << 14;
+
+  uint elapsed( std::chrono::high_resolution_clock::time_point start ) {
+    return (uint) std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+  }
+
+}
+
+int main() {
+
+  uint cores = std::thread::hardware_concurrency();
+  if( cores == 0 ) cores = 1;
+
+  printf( "Test parameters:\n\tCPU: %d core(s)\n\tdeque values: %d\n\tthieves: %d\n\ttasks: %d\n\tarray size: %d\n\tgrain: %d\n\n",
+    cores, deque_values, thieves_size, tasks_size, array_size, grain );
+
+  //the deque: the owner pops one value after every two pushes
+  {
+    atomic_deque<uint> deque0{ deque_capacity };
+    std::atomic<bool> done{ false };
+    std::atomic<unsigned long long> sum{ 0 };
+    std::atomic<uint> count{ 0 };
+
+    auto steal = [ &deque0, &done, &sum, &count ]() {
+      unsigned long long sum0 = 0;
+      uint count0 = 0;
+      uint value;
+      while( ! done.load( std::memory_order_acquire ) || ! deque0.empty() ) {
+        if( deque0.steal( value ) ) sum0 += value, count0++;
+        else std::this_thread::yield();
+      }
+      sum.fetch_add( sum0 );
+      count.fetch_add( count0 );
+    };
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::thread thieves[ thieves_size ];
+    for( auto& thief : thieves ) thief = std::thread{ steal };
+
+    unsigned long long sum0 = 0;
+    uint count0 = 0;
+    uint value;
+    for( uint i = 1; i <= deque_values; i++ ) {
+      deque0.push( i );
+      if( i % 2 == 0 && deque0.pop( value ) ) sum0 += value, count0++;
+    }
+    while( deque0.pop( value ) ) sum0 += value, count0++;
+
+    done.store( true, std::memory_order_release );
+    for( auto& thief : thieves ) thief.join();
+
+    uint time = elapsed( start );
+
+    unsigned long long expected = (unsigned long long) deque_values * ( deque_values + 1 ) / 2;
+    bool passed = sum.load() + sum0 == expected && count.load() + count0 == deque_values;
+
+    printf( "deque: %u values, owner took %u, thieves %u, %u us (%s)\n\n", deque_values, count0, count.load(), time, passed ? "Passed!" : "failed!" );
+  }
+
+  //the cost of a task
+  {
+    std::atomic<uint> counter{ 0 };
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::thread> threads( threads_tasks_size );
+    for( auto& thread : threads ) thread = std::thread{ [ &counter ]() { counter.fetch_add( 1, std::memory_order_relaxed ); } };
+    for( auto& thread : threads ) thread.join();
+
+    uint time_threads = elapsed( start );
+
+    task_pool pool0{ cores };
+
+    start = std::chrono::high_resolution_clock::now();
+
+    for( uint i = 0; i < tasks_size; i++ ) pool0.submit( [ &counter ]() { counter.fetch_add( 1, std::memory_order_relaxed ); } );
+    pool0.wait();
+
+    uint time_pool = elapsed( start );
+
+    bool passed = counter.load() == threads_tasks_size + tasks_size;
+
+    printf( "a task, ns:\n\tstd::thread per task: %u\n\ttask_pool::submit: %u\n(%s)\n\n",
+      (uint) ( time_threads * 1000ull / threads_tasks_size ), (uint) ( time_pool * 1000ull / tasks_size ), passed ? "Passed!" : "failed!" );
+  }
+
+  //scaling of parallel_for
+  {
+    std::vector<float> data( array_size );
+    for( uint i = 0; i < array_size; i++ ) data[ i ] = (float) ( i % 1024 );
+
+    std::vector<double> sums( array_size / grain + 1 );
+
+    auto chunk = [ &data, &sums ]( size_t first, size_t last ) {
+      double sum0 = 0;
+      for( size_t i = first; i < last; i++ ) sum0 += std::sqrt( data[ i ] );
+      sums[ first / grain ] = sum0;
+    };
+
+    double expected = 0;
+    bool passed = true;
+
+    printf( "parallel_for over %u elements\n%10s %12s %10s\n", array_size, "threads", "time, us", "speedup" );
+
+    uint time_one = 0;
+
+    for( uint threads_size = 1; ; threads_size = threads_size * 2 > cores && threads_size < cores ? cores : threads_size * 2 ) {
+
+      task_pool pool0{ threads_size };
+
+      auto start = std::chrono::high_resolution_clock::now();
+
+      pool0.parallel_for( 0, array_size, grain, chunk );
+
+      uint time = elapsed( start );
+
+      double sum = 0;
+      for( double sum0 : sums ) sum += sum0;
+
+      if( threads_size == 1 ) expected = sum, time_one = time;
+      passed = passed && sum == expected;
+
+      printf( "%10u %12u %10.2f\n", threads_size, time, (double) time_one / ( time ? time : 1 ) );
+
+      if( threads_size >= cores ) break;
+    }
+
+    printf( "parallel_for: %s\n", passed ? "Passed!" : "failed!" );
+  }
+
+  printf( "\ndone\n" );
+}
+
@@ -0,0 +1,271 @@
+#pragma once
+
+/*
+
+A fixed pool of worker threads that run small tasks, built on the work-stealing deque
+(atomic_deque.h) and the bounded queue (atomic_queue.h).
+
+Every worker has its own deque: a task submitted by a worker goes to the bottom of its deque and
+is usually run by the same worker (LIFO, hot in its cache), idle workers steal from the top of the
+other deques (the oldest and usually the biggest tasks). Tasks submitted by other threads go
+through a shared atomic_queue. A worker that found nothing sleeps on a condition variable, a
+submitter only takes the mutex when there are sleepers (the same scheme as the waits of atomic_queue).
+
+Waiting threads don't block while there are tasks: wait and parallel_for run tasks (their own,
+the shared ones, stolen ones) until their work is done, so a task can submit and wait for subtasks.
+
+API:
+
+create instance:
+
+  - task_pool( size_t threads = std::thread::hardware_concurrency() )
+  the destructor waits for the tasks and stops the workers
+
+methods:
+
+  - void submit( F fn )
+  runs fn() on a worker, fn must not throw
+
+  - void wait()
+  waits (running tasks) until all submitted tasks are done
+
+  - void parallel_for( size_t first, size_t last, size_t grain, F fn )
+  calls fn( begin, end ) for the chunks of [first, last) of at most grain elements: the range is
+  split in halves recursively, one half becomes a task (that can be stolen), waits for its chunks
+
+  - size_t size()
+  the number of workers
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+
+#include "atomic_pool.h"
+#include "atomic_deque.h"
+#include "atomic_queue.h"
+
+
+struct task_pool {
+
+  using uint = unsigned;
+  using size_t = std::size_t;
+
+  static const uint queue_capacity = 4096;
+
+  struct task {
+    std::function<void()> fn;
+    std::atomic<long>* group;
+
+    static void* operator new( std::size_t ) { return atomic_pool<task>::allocate(); }
+    static void operator delete( void* object ) { atomic_pool<task>::deallocate( object ); }
+  };
+
+  //the thread a worker runs on and its deque
+  struct worker {
+    atomic_deque<task*> tasks;
+    std::thread thread;
+  };
+
+  task_pool( size_t threads = std::thread::hardware_concurrency() ) {
+    if( threads == 0 ) threads = 1;
+    workers.reserve( threads );
+    for( size_t i = 0; i < threads; i++ ) workers.push_back( new worker{} );
+    for( size_t i = 0; i < threads; i++ ) workers[ i ]->thread = std::thread{ [ this, i ]() { run( i ); } };
+  }
+
+  task_pool( task_pool const& ) = delete;
+  task_pool& operator=( task_pool const& ) = delete;
+
+  ~task_pool() {
+    wait();
+    stop.store( true, std::memory_order_relaxed );
+    wake( true );
+    for( worker* worker0 : workers ) {
+      worker0->thread.join();
+      delete worker0;
+    }
+  }
+
+  template< typename U0 >
+  void submit( U0 fn ) {
+    submit( fn, pending );
+  }
+
+  void wait() {
+    wait( pending );
+  }
+
+  template< typename U0 >
+  void parallel_for( size_t first, size_t last, size_t grain, U0 fn ) {
+    std::atomic<long> group{ 0 };
+    split( first, last, grain == 0 ? 1 : grain, fn, group );
+    wait( group );
+  }
+
+  size_t size() const { return workers.size(); }
+
+  //the group counts the tasks that are not done yet
+  template< typename U0 >
+  void submit( U0 fn, std::atomic<long>& group ) {
+
+    group.fetch_add( 1, std::memory_order_relaxed );
+    if( &group != &pending ) pending.fetch_add( 1, std::memory_order_relaxed );
+
+    task* task0 = new task{ (U0&&) fn, &group };
+
+    worker* worker0 = local_worker();
+    if( worker0 ) worker0->tasks.push( task0 );
+    else shared.push( task0 );
+
+    wake( false );
+  }
+
+  //the range left after the splits is run by the caller
+  template< typename U0 >
+  void split( size_t first, size_t last, size_t grain, U0 const& fn, std::atomic<long>& group ) {
+    while( last - first > grain ) {
+      size_t middle = first + ( last - first ) / 2;
+      submit( [ this, middle, last, grain, &fn, &group ]() { split( middle, last, grain, fn, group ); }, group );
+      last = middle;
+    }
+    if( first < last ) fn( first, last );
+  }
+
+  //runs tasks until the group is done
+  void wait( std::atomic<long>& group ) {
+    while( group.load( std::memory_order_acquire ) > 0 ) {
+      if( ! run_one() ) std::this_thread::yield();
+    }
+  }
+
+  bool run_one() {
+    task* task0 = find();
+    if( ! task0 ) return false;
+    run_task( task0 );
+    return true;
+  }
+
+  //own deque, the shared queue, then the other deques starting from a random one
+  task* find() {
+
+    task* task0 = nullptr;
+
+    worker* worker0 = local_worker();
+    if( worker0 && worker0->tasks.pop( task0 ) ) return task0;
+
+    if( shared.try_pop( task0 ) ) return task0;
+
+    size_t size0 = workers.size();
+    size_t start = random() % size0;
+    for( size_t i = 0; i < size0; i++ ) {
+      worker* victim = workers[ ( start + i ) % size0 ];
+      if( victim != worker0 && victim->tasks.steal( task0 ) ) return task0;
+    }
+
+    return nullptr;
+  }
+
+  //Worker
+  //a worker sleeps when it found nothing after it has announced itself, a submitter either sees it
+  //or its task is seen by the last find
+  void run( size_t index ) {
+
+    local() = { this, workers[ index ] };
+
+    while( ! stop.load( std::memory_order_relaxed ) ) {
+
+      if( run_one() ) continue;
+
+      uint signals0 = signals.load( std::memory_order_relaxed );
+      sleepers.fetch_add( 1, std::memory_order_relaxed );
+      std::atomic_thread_fence( std::memory_order_seq_cst );
+
+      if( task* task0 = find() ) {
+        sleepers.fetch_sub( 1, std::memory_order_relaxed );
+        run_task( task0 );
+        continue;
+      }
+
+      {
+        std::unique_lock<std::mutex> lock_guard{ lock };
+        while( signals.load( std::memory_order_relaxed ) == signals0 && ! stop.load( std::memory_order_relaxed ) ) signal.wait( lock_guard );
+      }
+
+      sleepers.fetch_sub( 1, std::memory_order_relaxed );
+    }
+
+    local() = { nullptr, nullptr };
+  }
+
+  void run_task( task* task0 ) {
+    task0->fn();
+    std::atomic<long>* group = task0->group;
+    delete task0;
+    if( group != &pending ) pending.fetch_sub( 1, std::memory_order_release );
+    group->fetch_sub( 1, std::memory_order_release );
+  }
+
+  void wake( bool all ) {
+    signals.fetch_add( 1, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    if( ! all && sleepers.load( std::memory_order_relaxed ) == 0 ) return;
+    std::lock_guard<std::mutex> lock_guard{ lock };
+    if( all ) signal.notify_all();
+    else signal.notify_one();
+  }
+
+  //the worker of the current thread in this pool
+  worker* local_worker() {
+    auto& local0 = local();
+    return local0.pool == this ? local0.worker0 : nullptr;
+  }
+
+  struct local_t {
+    task_pool* pool;
+    worker* worker0;
+  };
+
+  static local_t& local() {
+    thread_local local_t local0{ nullptr, nullptr };
+    return local0;
+  }
+
+  //xorshift per thread
+  static uint random() {
+    thread_local uint state = (uint) (std::uintptr_t) &state | 1;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  std::vector<worker*> workers;
+
+  atomic_queue<task*, queue_capacity> shared;
+
+  //all the tasks that are not done yet
+  std::atomic<long> pending{ 0 };
+
+  std::atomic<bool> stop{ false };
+
+  std::atomic<uint> signals{ 0 };
+  std::atomic<uint> sleepers{ 0 };
+  std::mutex lock;
+  std::condition_variable signal;
+
+};
+
+
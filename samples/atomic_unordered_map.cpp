@@ -0,0 +1,229 @@
+/*
+
+atomic_unordered_map against atomic_data_mutex< std::unordered_map > and atomic_hash_map on the
+workload of atomic_map and atomic_hash_map, with 1M keys and 64 threads.
+
+First the threads fill the maps, each with its own range of keys. atomic_unordered_map starts with
+a small table, so it is resized many times during the run. Then half of the threads increment the
+values of random keys and the other half look up random keys. At the end we check that every key
+is there and that no increments are lost. Then for_each walks a map while another thread grows it:
+every entry must be visited once.
+
+atomic_data< std::map > is not in the table: a queue of full copies of a 1M map doesn't fit in
+memory (see atomic_hash_map.cpp for the sizes it can handle).
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+
+#include "atomic_data_mutex.h"
+#include "atomic_hash_map.h"
+#include "atomic_unordered_map.h"
+
+namespace {
+
+  using uint = unsigned;
+
+  //edit to change the test setup
+  const uint keys_size = 1000000;
+  const uint iterations = 4096;
+  const uint threads_size = 64;
+
+  using map = std::unordered_map<uint, uint>;
+  using atomic_map_mutex_t = atomic_data_mutex<map>;
+  using atomic_hash_map_t = atomic_hash_map<uint, uint, std::hash<uint>, threads_size * 2>;
+  using atomic_unordered_map_t = atomic_unordered_map<uint, uint, std::hash<uint>, threads_size * 2>;
+
+  volatile uint global_dummy;
+
+  //the same syntax for all map types
+  void insert( atomic_map_mutex_t& map0, uint key ) {
+    map0.update( [ key ]( map* map1 ) { map1->emplace( key, 1 ); return true; } );
+  }
+
+  void insert( atomic_hash_map_t& map0, uint key ) {
+    map0.update( [ key ]( atomic_hash_map_t::version* map1 ) { map1->insert_or_assign( key, 1 ); return true; } );
+  }
+
+  void insert( atomic_unordered_map_t& map0, uint key ) {
+    map0.insert_or_assign( key, 1 );
+  }
+
+  void increment( atomic_map_mutex_t& map0, uint key ) {
+    map0.update( [ key ]( map* map1 ) { (*map1)[ key ]++; return true; } );
+  }
+
+  void increment( atomic_hash_map_t& map0, uint key ) {
+    map0.update( [ key ]( atomic_hash_map_t::version* map1 ) {
+      uint const* value = map1->find( key );
+      map1->insert_or_assign( key, value ? *value + 1 : 1 );
+      return true;
+    } );
+  }
+
+  void increment( atomic_unordered_map_t& map0, uint key ) {
+    map0.update( key, []( uint& value ) { value++; } );
+  }
+
+  uint find( atomic_map_mutex_t& map0, uint key ) {
+    return map0.read( [ key ]( map* map1 ) {
+      auto i = map1->find( key );
+      return i == map1->end() ? 0 : i->second;
+    } );
+  }
+
+  uint find( atomic_hash_map_t& map0, uint key ) {
+    return map0.read( [ key ]( atomic_hash_map_t::version* map1 ) {
+      uint const* value = map1->find( key );
+      return value ? *value : 0;
+    } );
+  }
+
+  uint find( atomic_unordered_map_t& map0, uint key ) {
+    uint value = 0;
+    map0.find( key, value );
+    return value;
+  }
+
+  uint elapsed( std::chrono::high_resolution_clock::time_point start ) {
+    return (uint) std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+  }
+
+}
+
+template< typename T > bool test_map( T& map0, uint& time_fill, uint& time_update );
+
+int main() {
+
+  printf( "Test parameters:\n\tCPU: %d core(s)\n\tkeys: %d\n\tupdates/thread: %d\n\tthreads: %d\n\n",
+    std::thread::hardware_concurrency(), keys_size, iterations, threads_size );
+
+  printf( "time in milliseconds\n" );
+  printf( "%22s %10s %10s\n", "", "fill", "update" );
+
+  bool passed = true;
+  uint time_fill, time_update;
+
+  {
+    atomic_map_mutex_t atomic_map_mutex;
+    passed = test_map( atomic_map_mutex, time_fill, time_update ) && passed;
+    printf( "%22s %10u %10u\n", "atomic_map_mutex", time_fill, time_update );
+  }
+
+  {
+    atomic_hash_map_t atomic_hash_map0;
+    passed = test_map( atomic_hash_map0, time_fill, time_update ) && passed;
+    printf( "%22s %10u %10u\n", "atomic_hash_map", time_fill, time_update );
+  }
+
+  {
+    atomic_unordered_map_t atomic_unordered_map0;
+    passed = test_map( atomic_unordered_map0, time_fill, time_update ) && passed;
+    printf( "%22s %10u %10u\n", "atomic_unordered_map", time_fill, time_update );
+
+    uint size = (uint) atomic_unordered_map0.size();
+    uint sum = 0, count = 0;
+    atomic_unordered_map0.for_each( [ &sum, &count ]( uint, uint value ) { sum += value; count++; } );
+
+    printf( "\natomic_unordered_map: %u buckets, size %u, for_each: %u entries\n", (uint) atomic_unordered_map0.bucket_count(), size, count );
+
+    passed = passed && size == keys_size && count == keys_size && sum == keys_size + iterations * ( threads_size / 2 );
+  }
+
+  //for_each during resizes: a thread adds keys (the table doubles several times), the first keys
+  //must be seen exactly once by every for_each
+  {
+    atomic_unordered_map_t atomic_unordered_map0;
+    for( uint key = 0; key < 1000; key++ ) atomic_unordered_map0.insert_or_assign( key, 1 );
+
+    std::atomic<bool> done{ false };
+    std::thread thread0{ [ &atomic_unordered_map0, &done ]() {
+      for( uint key = keys_size; key < keys_size * 2; key++ ) atomic_unordered_map0.insert_or_assign( key, 1 );
+      done.store( true );
+    } };
+
+    uint walks = 0, errors = 0;
+    while( ! done.load() ) {
+      uint count = 0;
+      atomic_unordered_map0.for_each( [ &count ]( uint key, uint ) { if( key < 1000 ) count++; } );
+      if( count != 1000 ) errors++;
+      walks++;
+    }
+
+    thread0.join();
+
+    printf( "for_each during resizes: %u walks (%s)\n", walks, errors == 0 ? "Passed!" : "failed!" );
+
+    passed = passed && errors == 0;
+  }
+
+  printf( "\n%s\n", passed ? "Passed!" : "failed!" );
+
+  printf( "\ndone\n" );
+}
+
+//test function
+//the threads fill the map with their ranges of keys, then half of them increment values of random keys,
+//the other half read, returns false if a key or an increment is lost
+template< typename T >
+bool test_map( T& map0, uint& time_fill, uint& time_update ) {
+
+  auto fill = [ &map0 ]( uint thread_id ) {
+    for( uint key = thread_id; key < keys_size; key += threads_size ) insert( map0, key );
+  };
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  std::thread threads[ threads_size ];
+  for( uint i = 0; i < threads_size; i++ ) threads[ i ] = std::thread{ fill, i };
+  for( auto& thread : threads ) thread.join();
+
+  time_fill = elapsed( start );
+
+  auto update = [ &map0 ]( uint thread_id ) {
+    std::mt19937_64 gen0( thread_id );
+    std::uniform_int_distribution<uint> engine0{ 0, keys_size - 1 };
+    for( uint i = 0; i < iterations; i++ ) increment( map0, engine0( gen0 ) );
+  };
+
+  auto read = [ &map0 ]( uint thread_id ) {
+    std::mt19937_64 gen0( thread_id );
+    std::uniform_int_distribution<uint> engine0{ 0, keys_size - 1 };
+    for( uint i = 0; i < iterations; i++ ) {
+      global_dummy = find( map0, engine0( gen0 ) );
+      if( i % 16 == 0 ) std::this_thread::yield();
+    }
+  };
+
+  start = std::chrono::high_resolution_clock::now();
+
+  for( uint i = 0; i < threads_size; i++ ) threads[ i ] = i % 2 == 0 ? std::thread{ update, i } : std::thread{ read, i };
+  for( auto& thread : threads ) thread.join();
+
+  time_update = elapsed( start );
+
+  uint sum = 0;
+  bool found = true;
+  for( uint key = 0; key < keys_size; key++ ) {
+    uint value = find( map0, key );
+    found = found && value != 0;
+    sum += value;
+  }
+
+  uint total = keys_size + iterations * ( threads_size / 2 );
+  if( ! found || sum != total ) printf( "failed! sum = %u, expected %u\n", sum, total );
+
+  return found && sum == total;
+}
+
@@ -0,0 +1,424 @@
+#pragma once
+
+/*
+
+A concurrent hash map with an atomic_data per bucket and an incremental resize.
+
+atomic_data< std::map > copies the whole map on every update. atomic_unordered_map is an array of
+buckets, every bucket is an atomic_data< bucket > holding a small vector of entries: an update
+copies one bucket (the queue of atomic_data reuses its elements, so the vectors keep their
+capacity and a copy usually doesn't allocate). Reads are wait-free, updates of different buckets
+don't conflict.
+
+The array is a reference counted table published with atomic_data (the current table and the next
+one during a resize). When the number of entries goes over max_load per bucket a table of double
+the size is published as the next one and every update after that moves a few buckets (claimed
+with an atomic increment) to it, so no operation rehashes the whole map. A bucket is moved by
+freezing it in the old table (an update, no more changes to it) and filling the two buckets of the
+new table it maps to, each with a single update that happens before any other change to it. While
+the resize is in progress the updates go to the new table (filling their bucket first if needed),
+a lookup takes a bucket that isn't frozen from the old table and otherwise the new bucket if it's
+filled. The last mover publishes the new table as the current one, the old one is freed with the
+last version referencing it.
+
+API:
+
+create instance:
+
+  - atomic_unordered_map< key_type, value_type, hash = std::hash< key_type >, queue_size = 8 >
+  queue_size is passed to atomic_data (the buckets of all maps of the same type share the queue)
+
+methods:
+
+  - bool insert_or_assign( key_type const& key, value_type value )
+  returns true if the key was added
+
+  - void update( key_type const& key, F fn )
+  calls fn( value_type& ) for the value of the key, value_type{ } is inserted if there is no such key
+
+  - bool erase( key_type const& key )
+  - bool find( key_type const& key, value_type& value ) const
+
+  - void for_each( F ) const
+  F accepts a key and a value, every entry is visited once, also during a resize: a bucket is read
+  as it is or, if a resize has frozen it, as it was at the freeze (later changes are not seen)
+
+  - size_t size() const
+  sharded counter (atomic_counter.h), approximate while there are updates in flight
+
+  - size_t bucket_count() const
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <functional>
+
+#include "atomic_data.h"
+#include "atomic_shared.h"
+#include "atomic_counter.h"
+
+
+template< typename K0, typename V0, typename H0 = std::hash<K0>, unsigned N0 = 8 >
+struct atomic_unordered_map {
+
+  using size_t = std::size_t;
+
+  static const size_t initial_size = 16;
+  static const size_t max_load = 2;
+
+  //buckets moved by an update during a resize
+  static const size_t migrate_step = 16;
+
+  //frozen: moved to the next table, never changes again
+  //filled: has the entries of the bucket of the previous table (false in a new table until it's moved)
+  struct bucket {
+    std::vector<std::pair<K0, V0>> entries;
+    bool frozen = false;
+    bool filled = true;
+
+    V0* find( K0 const& key ) {
+      for( auto& entry : entries ) if( entry.first == key ) return &entry.second;
+      return nullptr;
+    }
+  };
+
+  using atomic_bucket = atomic_data<bucket, N0>;
+
+  struct table : shared_base {
+
+    table( size_t size_, bool filled ) : size{ size_ } {
+      buckets.reserve( size );
+      for( size_t i = 0; i < size; i++ ) buckets.emplace_back( new bucket{ { }, false, filled } );
+    }
+
+    size_t size;
+    std::vector<atomic_bucket> buckets;
+
+    //the buckets claimed and moved by a resize
+    std::atomic<size_t> claimed{ 0 };
+    std::atomic<size_t> moved{ 0 };
+  };
+
+  using table_ptr = shared_ref<table>;
+
+  //data_type of atomic_data
+  struct state {
+    table_ptr current;
+    table_ptr next;
+  };
+
+  using guard = typename atomic_data<state, N0>::guard;
+
+  //the bucket index is the low bits of the hash, std::hash of an integer is often the integer itself
+  static size_t hash_of( K0 const& key ) {
+    uint64_t hash = H0{ }( key );
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    return (size_t) hash;
+  }
+
+  atomic_unordered_map() : root{ new state{ table_ptr{ new table{ initial_size, true } }, table_ptr{ } } } { }
+
+  atomic_unordered_map( atomic_unordered_map const& ) = delete;
+  atomic_unordered_map& operator=( atomic_unordered_map const& ) = delete;
+
+  bool insert_or_assign( K0 const& key, V0 value ) {
+    return modify( key, [ &key, &value ]( bucket* bucket0, int& change ) {
+      if( V0* value0 = bucket0->find( key ) ) {
+        *value0 = value;
+        return true;
+      }
+      bucket0->entries.emplace_back( key, value );
+      change = 1;
+      return true;
+    } ) > 0;
+  }
+
+  template< typename U0 >
+  void update( K0 const& key, U0 fn ) {
+    modify( key, [ &key, &fn ]( bucket* bucket0, int& change ) {
+      if( V0* value0 = bucket0->find( key ) ) {
+        fn( *value0 );
+        return true;
+      }
+      bucket0->entries.emplace_back( key, V0{ } );
+      fn( bucket0->entries.back().second );
+      change = 1;
+      return true;
+    } );
+  }
+
+  bool erase( K0 const& key ) {
+    return modify( key, [ &key ]( bucket* bucket0, int& change ) {
+      auto& entries = bucket0->entries;
+      for( size_t i = 0; i < entries.size(); i++ ) {
+        if( entries[ i ].first == key ) {
+          if( i + 1 != entries.size() ) entries[ i ] = (std::pair<K0, V0>&&) entries.back();
+          entries.pop_back();
+          change = -1;
+          return true;
+        }
+      }
+      return false;
+    } ) < 0;
+  }
+
+  bool find( K0 const& key, V0& value ) const {
+
+    size_t hash = hash_of( key );
+
+    auto find0 = [ &key, &value ]( bucket* bucket0, bool& found ) {
+      V0* value0 = bucket0->find( key );
+      found = value0 != nullptr;
+      if( found ) value = *value0;
+    };
+
+    guard guard0{ };
+
+    while( true ) {
+
+      state* state0 = root.read( guard0, []( state* state1 ) { return state1; } );
+      table* current = state0->current.get();
+      table* next = state0->next.get();
+
+      bool found = false;
+
+      bool frozen = current->buckets[ hash & ( current->size - 1 ) ].read( [ &find0, &found ]( bucket* bucket0 ) {
+        if( bucket0->frozen ) return true;
+        find0( bucket0, found );
+        return false;
+      } );
+
+      if( ! frozen ) return found;
+
+      //a resize has started after the state was read
+      if( ! next ) continue;
+
+      bool filled = false;
+      frozen = next->buckets[ hash & ( next->size - 1 ) ].read( [ &find0, &found, &filled ]( bucket* bucket0 ) {
+        if( bucket0->frozen ) return true;
+        filled = bucket0->filled;
+        if( filled ) find0( bucket0, found );
+        return false;
+      } );
+
+      if( frozen ) continue;
+
+      //nothing was changed in the new bucket, the frozen one is current
+      if( ! filled ) {
+        current->buckets[ hash & ( current->size - 1 ) ].read( [ &find0, &found ]( bucket* bucket0 ) {
+          find0( bucket0, found );
+        } );
+      }
+
+      return found;
+    }
+  }
+
+  template< typename U0 >
+  void for_each( U0 fn ) const {
+
+    guard guard0{ };
+
+    state* state0 = root.read( guard0, []( state* state1 ) { return state1; } );
+    table* current = state0->current.get();
+    table* next = state0->next.get();
+
+    auto visit = [ &fn ]( bucket* bucket0, table* next, size_t index ) {
+      for( auto& entry : bucket0->entries ) {
+        if( ! next || ( hash_of( entry.first ) & ( next->size - 1 ) ) == index ) fn( (K0 const&) entry.first, (V0 const&) entry.second );
+      }
+    };
+
+    for( size_t i = 0; i < current->size; i++ ) {
+
+      //a bucket frozen by a resize that started after the state was read holds all its entries
+      //as of the freeze and never changes again: it's visited as is
+      bool frozen = current->buckets[ i ].read( [ &visit, next ]( bucket* bucket0 ) {
+        if( bucket0->frozen && next ) return true;
+        visit( bucket0, nullptr, 0 );
+        return false;
+      } );
+
+      if( ! frozen ) continue;
+
+      for( size_t j : { i, i + current->size } ) {
+        bool filled = next->buckets[ j ].read( [ &visit ]( bucket* bucket0 ) {
+          if( bucket0->filled ) visit( bucket0, nullptr, 0 );
+          return bucket0->filled;
+        } );
+        if( ! filled ) current->buckets[ i ].read( [ &visit, next, j ]( bucket* bucket0 ) { visit( bucket0, next, j ); } );
+      }
+    }
+  }
+
+  size_t size() const {
+    return counter.load();
+  }
+
+  size_t bucket_count() const {
+    return root.read( []( state* state0 ) { return state0->current->size; } );
+  }
+
+  //Update of a Bucket
+  //fn( bucket*, int& change ) changes the bucket and the size, it returns false if there is nothing
+  //to change (the bucket isn't published, an erase of a missing key is a read), the state is read under a
+  //guard (the tables stay alive), the resize is started and finished after the guard is gone: an
+  //update of the state under its own guard could wait at the sync barrier for that guard
+  template< typename U0 >
+  int modify( K0 const& key, U0 fn ) {
+
+    size_t hash = hash_of( key );
+
+    int change = 0;
+    table* grow = nullptr;
+    table* done = nullptr;
+
+    {
+      guard guard0{ };
+
+      while( true ) {
+
+        state* state0 = root.read( guard0, []( state* state1 ) { return state1; } );
+        table* current = state0->current.get();
+        table* next = state0->next.get();
+
+        table* target = current;
+
+        if( next ) {
+          migrate( current, next );
+          fill( current, next, hash & ( next->size - 1 ) );
+          target = next;
+        }
+
+        bool frozen = false, unchanged = false;
+
+        auto& bucket0 = target->buckets[ hash & ( target->size - 1 ) ];
+
+        while( ! bucket0.update_weak( [ &fn, &change, &frozen, &unchanged ]( bucket* bucket1 ) {
+          frozen = bucket1->frozen;
+          if( frozen ) return false;
+          change = 0;
+          unchanged = ! fn( bucket1, change );
+          return ! unchanged;
+        } ) && ! frozen && ! unchanged );
+
+        //a resize has started after the state was read
+        if( frozen ) continue;
+
+        if( change ) counter.add( change );
+
+        if( next && current->moved.load( std::memory_order_acquire ) == current->size ) done = current;
+        if( ! next && change > 0 && counter.load() > current->size * max_load ) grow = current;
+
+        break;
+      }
+    }
+
+    if( grow ) start_resize( grow );
+    if( done ) finish_resize( done );
+
+    return change;
+  }
+
+  //Resize
+  //moves the next claimed buckets
+  void migrate( table* current, table* next ) {
+
+    size_t first = current->claimed.fetch_add( migrate_step, std::memory_order_relaxed );
+
+    if( first >= current->size ) return;
+
+    size_t last = first + migrate_step < current->size ? first + migrate_step : current->size;
+
+    for( size_t i = first; i < last; i++ ) {
+      fill( current, next, i );
+      fill( current, next, i + current->size );
+    }
+
+    current->moved.fetch_add( last - first, std::memory_order_release );
+  }
+
+  //freezes the old bucket of the new bucket index and fills the new one (once)
+  static void fill( table* current, table* next, size_t index ) {
+
+    auto& bucket_new = next->buckets[ index ];
+
+    if( bucket_new.read( []( bucket* bucket0 ) { return bucket0->filled; } ) ) return;
+
+    auto& bucket_old = current->buckets[ index & ( current->size - 1 ) ];
+
+    bool frozen = false;
+
+    while( ! bucket_old.update_weak( [ &frozen ]( bucket* bucket0 ) {
+      frozen = bucket0->frozen;
+      if( frozen ) return false;
+      bucket0->frozen = true;
+      return true;
+    } ) && ! frozen );
+
+    //the frozen bucket doesn't change, its entries can be copied outside of the update
+    std::vector<std::pair<K0, V0>> entries;
+
+    bucket_old.read( [ &entries, next, index ]( bucket* bucket0 ) {
+      for( auto& entry : bucket0->entries ) {
+        if( ( hash_of( entry.first ) & ( next->size - 1 ) ) == index ) entries.push_back( entry );
+      }
+    } );
+
+    bool filled = false;
+
+    while( ! bucket_new.update_weak( [ &entries, &filled ]( bucket* bucket0 ) {
+      filled = bucket0->filled;
+      if( filled ) return false;
+      bucket0->entries = entries;
+      bucket0->filled = true;
+      return true;
+    } ) && ! filled );
+  }
+
+  void start_resize( table* current ) {
+
+    table_ptr next{ new table{ current->size * 2, false } };
+
+    bool started = false;
+
+    while( ! root.update_weak( [ current, &next, &started ]( state* state0 ) {
+      started = state0->current.get() != current || state0->next;
+      if( started ) return false;
+      state0->next = next;
+      return true;
+    } ) && ! started );
+  }
+
+  void finish_resize( table* current ) {
+
+    bool finished = false;
+
+    while( ! root.update_weak( [ current, &finished ]( state* state0 ) {
+      finished = state0->current.get() != current;
+      if( finished ) return false;
+      state0->current = state0->next;
+      state0->next.reset();
+      return true;
+    } ) && ! finished );
+  }
+
+  atomic_data<state, N0> root;
+
+  sharded_counter<> counter;
+
+};
+
+
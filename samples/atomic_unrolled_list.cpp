@@ -0,0 +1,156 @@
+/*
+
+atomic_unrolled_list against atomic_list (one element per node).
+
+The lists are filled with push_front, then we measure a traversal summing all elements and
+the memory per element (node data and atomic_data wrappers, both from the node pool).
+Then threads insert and erase at random positions, an equal number of each: at the end the
+size should be the same.
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstdio>
+#include <thread>
+#include <random>
+#include <chrono>
+
+#include "atomic_list.h"
+#include "atomic_unrolled_list.h"
+
+namespace {
+
+  using uint = unsigned;
+
+  //edit to change the test setup
+  const uint threads_size = 4;
+  const uint iterations = 4096;
+  const uint list_size = 100000;
+  const uint random_list_size = 1000;
+  const uint walk_repeats = 16;
+  const uint node_size = 32;
+
+  using atomic_list_t = atomic_list<uint, threads_size * 2>;
+  using atomic_unrolled_list_t = atomic_unrolled_list<uint, node_size, threads_size * 2>;
+
+  template< typename T > size_t block_size() { return sizeof( typename atomic_pool<T>::block ); }
+
+  //the same syntax for both lists
+  void push_front( atomic_list_t& list0, uint value ) { list0.push_front( value ); }
+  void push_front( atomic_unrolled_list_t& list0, uint value ) { list0.push_front( value ); }
+
+  bool insert_weak( atomic_list_t& list0, uint index, uint value ) {
+    auto it = list0.advance( index );
+    return it ? (bool) list0.insert_after_weak( it, value ) : (bool) list0.push_front( value );
+  }
+
+  bool insert_weak( atomic_unrolled_list_t& list0, uint index, uint value ) {
+    return list0.insert_weak( index, value );
+  }
+
+  bool erase_weak( atomic_list_t& list0, uint index ) {
+    if( index == 0 ) return list0.pop_front();
+    auto it = list0.advance( index - 1 );
+    return it && list0.erase_after_weak( it );
+  }
+
+  bool erase_weak( atomic_unrolled_list_t& list0, uint index ) {
+    return list0.erase_weak( index );
+  }
+
+  //bytes per element: the pool blocks of the nodes and their atomic_data wrappers
+  size_t memory( atomic_list_t& ) {
+    return block_size<atomic_list_t::node>() + block_size<atomic_list_t::atomic_node>();
+  }
+
+  size_t memory( atomic_unrolled_list_t& list0 ) {
+    size_t nodes = 0;
+    list0.for_each_node( [ &nodes ]( uint const*, size_t ) { nodes++; } );
+    size_t bytes = nodes * ( block_size<atomic_unrolled_list_t::node>() + block_size<atomic_unrolled_list_t::atomic_node>() );
+    return bytes / list0.size();
+  }
+
+}
+
+template< typename T > void test_list( char const* name );
+
+int main() {
+
+  printf( "Test parameters:\n\tCPU: %d core(s)\n\tlist size: %d\n\tnode size: %d\n\titerations/thread: %d\n\tthreads: %d\n\n",
+    std::thread::hardware_concurrency(), list_size, node_size, iterations, threads_size );
+
+  printf( "%22s %10s %10s %10s %8s %s\n", "", "fill, us", "walk, us", "random, us", "bytes", "" );
+
+  test_list<atomic_list_t>( "atomic_list" );
+  test_list<atomic_unrolled_list_t>( "atomic_unrolled_list" );
+
+  printf( "\ndone\n" );
+}
+
+//test function
+template< typename T >
+void test_list( char const* name ) {
+
+  T list0;
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  for( uint i = 0; i < list_size; i++ ) push_front( list0, i );
+
+  uint time_fill = (uint) std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+
+  start = std::chrono::high_resolution_clock::now();
+
+  uint sum = 0;
+  for( uint i = 0; i < walk_repeats; i++ ) list0.for_each( [ &sum ]( uint value ) { sum += value; } );
+
+  uint time_walk = (uint) std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count() / walk_repeats;
+
+  uint sum_expected = 0;
+  for( uint i = 0; i < list_size; i++ ) sum_expected += i;
+
+  bool passed = sum == sum_expected * walk_repeats;
+
+  size_t bytes = memory( list0 );
+
+  list0.clear();
+
+  //random positions
+  for( uint i = 0; i < random_list_size; i++ ) push_front( list0, i );
+
+  auto fn_insert = [ &list0 ]() {
+    std::uniform_int_distribution<uint> engine0{ 0, random_list_size };
+    std::mt19937_64 gen0( std::chrono::high_resolution_clock::now().time_since_epoch().count() );
+    for( uint i = 0; i < iterations; i++ ) {
+      while( ! insert_weak( list0, engine0( gen0 ), i ) ) std::this_thread::yield();
+    }
+  };
+
+  auto fn_erase = [ &list0 ]() {
+    std::uniform_int_distribution<uint> engine0{ 0, random_list_size / 2 };
+    std::mt19937_64 gen0( std::chrono::high_resolution_clock::now().time_since_epoch().count() );
+    for( uint i = 0; i < iterations; i++ ) {
+      while( ! erase_weak( list0, engine0( gen0 ) ) ) std::this_thread::yield();
+    }
+  };
+
+  start = std::chrono::high_resolution_clock::now();
+
+  std::thread threads[ threads_size ];
+  for( uint i = 0; i < threads_size; i++ ) threads[ i ] = i % 2 == 0 ? std::thread{ fn_erase } : std::thread{ fn_insert };
+  for( auto& thread : threads ) thread.join();
+
+  uint time_random = (uint) std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+
+  passed = passed && list0.size() == random_list_size && list0.size_exact() == random_list_size;
+
+  printf( "%22s %10u %10u %10u %8u %s\n", name, time_fill, time_walk, time_random, (uint) bytes, passed ? "Passed!" : "failed!" );
+
+  list0.clear();
+}
+
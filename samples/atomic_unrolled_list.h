@@ -0,0 +1,369 @@
+#pragma once
+
+/*
+
+An unrolled singly linked list using atomic_data: every node holds up to K elements.
+
+atomic_list keeps one element per node, so per element it pays for the node data, the
+atomic_data wrapper with its reference count, the flags and a pointer chase on traversal.
+atomic_unrolled_list packs the elements into arrays of K, the elements of a node are scanned
+contiguously and the per node costs are shared by up to K elements.
+
+An insertion into a full node splits it: the node keeps the first half, a new node gets the
+second half, both in one update of the node (the new node is private until it's published).
+An erasure that leaves a node small merges it with the next one: the next node is marked
+(frozen), then the update of the first node takes over its elements and links past it.
+A marked node is never modified again: whoever meets it replaces the link to it in the previous
+node (merges it, unlinks it if it's empty or replaces it with an unmarked copy if it doesn't
+fit), so a failed merge is finished by a later traversal instead of rolled back.
+Positions are taken by a borrowed traversal under one read guard (see atomic_list.h).
+
+API:
+
+create instance:
+
+  - atomic_unrolled_list< data_type, node_size = 32, queue_size = 8, domain = void >
+  node_size is the maximum number of elements in a node, queue_size is passed to atomic_data
+  nodes come from a node pool (atomic_pool.h), lists with different domain types don't share the
+  queue of atomic_data and the pool
+
+methods:
+
+  - bool insert_weak( size_t index, data_type value )
+  inserts the value before the element at index (at the end if index is bigger than the size)
+  fails on contention (you might call it in a loop and yield on failure)
+
+  - bool erase_weak( size_t index, data_type* value = nullptr )
+  erases the element at index, stores it in value, fails if there is no such element or on contention
+
+  - void push_front( data_type value )
+  - bool pop_front( data_type* value = nullptr )
+  never fail, pop_front returns false if the list is empty
+
+  - void for_each( F )
+  - void for_each_node( F )
+  read-only borrowed traversals, F accepts data_type const& or a span of a node:
+  ( data_type const* data, size_t size )
+
+  - size_t size()
+  O(1), sharded counter (atomic_counter.h), approximate while there are updates in flight
+
+  - size_t size_exact()
+  - bool empty()
+  - void clear()
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstddef>
+
+#include "atomic_data.h"
+#include "atomic_shared.h"
+#include "atomic_pool.h"
+#include "atomic_counter.h"
+
+
+template< typename T0, unsigned K0 = 32, unsigned N0 = 8, typename D0 = void >
+struct atomic_unrolled_list {
+
+  static_assert( K0 >= 4, "node_size for the atomic_unrolled_list must be at least 4" );
+
+  using size_t = std::size_t;
+  using uint = unsigned;
+
+  struct node;
+  struct atomic_node;
+
+  using node_ptr = shared_ref<atomic_node>;
+  using guard = typename atomic_data<node, N0>::guard;
+
+  //locked is the mark: a marked node is frozen and gets replaced by the update of the previous node
+  struct node {
+
+    T0 data[ K0 ];
+    uint size;
+    node_ptr next;
+    bool locked;
+
+    static void* operator new( std::size_t ) { return atomic_pool<node>::allocate(); }
+    static void operator delete( void* object ) { atomic_pool<node>::deallocate( object ); }
+  };
+
+  struct atomic_node : shared_base, atomic_data<node, N0> {
+
+    atomic_node( node* node0 = new node{ } ) : atomic_data<node, N0>{ node0 } { }
+
+    static void* operator new( std::size_t ) { return atomic_pool<atomic_node>::allocate(); }
+    static void operator delete( void* object ) { atomic_pool<atomic_node>::deallocate( object ); }
+  };
+
+
+  //the head holds no elements and is never marked
+  atomic_unrolled_list() : head{ new atomic_node{} } { }
+
+  //the nodes are released one by one, a long chain of references would recurse
+  ~atomic_unrolled_list() {
+    clear();
+  }
+
+
+  //Borrowed Traversal
+  //the versions read under the guard are not reused and keep the next nodes alive (see atomic_list.h)
+  //fn( atomic_node* prev, atomic_node*, node* ) returns false to stop at a node, returns that node or nullptr
+  //prev is the last unmarked node before, with snip the marked nodes on the way are replaced (best effort)
+  //a marked node is frozen: its elements are still visited and the walk goes on from it
+  template< typename U0 >
+  atomic_node* scan( guard const& guard0, U0 fn, bool snip = false ) const {
+    atomic_node* prev = head.get();
+    node* node0 = prev->read( guard0, []( node* node1 ) { return node1; } );
+    for( atomic_node* it = node0->next.get(); it; it = node0->next.get() ) {
+      node0 = it->read( guard0, []( node* node1 ) { return node1; } );
+      if( node0->locked && snip ) replace( prev, it );
+      if( ! fn( prev, it, node0 ) ) return it;
+      if( ! node0->locked ) prev = it;
+    }
+    return nullptr;
+  }
+
+  //replaces the link from prev to a marked node: merges it into prev if it fits, unlinks it
+  //if it's empty, links an unmarked copy otherwise
+  bool replace( atomic_node* prev, atomic_node* node_marked ) const {
+
+    node frozen;
+
+    bool marked = node_marked->read( [ &frozen ]( node* node0 ) {
+      if( ! node0->locked ) return false;
+      frozen = *node0;
+      return true;
+    } );
+
+    if( ! marked ) return false;
+
+    bool is_head = prev == head.get();
+
+    return prev->update_weak( [ node_marked, &frozen, is_head ]( node* node0 ) {
+
+      if( node0->locked || node0->next.get() != node_marked ) return false;
+
+      if( frozen.size == 0 ) {
+        node0->next = frozen.next;
+      } else if( is_head || node0->size + frozen.size > K0 ) {
+        node* node_copy = new node( frozen );
+        node_copy->locked = false;
+        node0->next = node_ptr{ new atomic_node{ node_copy } };
+      } else {
+        for( uint i = 0; i < frozen.size; i++ ) node0->data[ node0->size + i ] = frozen.data[ i ];
+        node0->size += frozen.size;
+        node0->next = frozen.next;
+      }
+
+      return true;
+    } );
+  }
+
+  //finds the node with the element at index: the offset in the node, the previous unmarked node
+  //and the version of the node the offset was found in (it isn't reused while the guard is held)
+  //with append the last node is returned for an index past the end (the head for an empty list)
+  atomic_node* locate( guard const& guard0, size_t index, size_t& offset, atomic_node*& prev, node*& version, bool append ) const {
+
+    atomic_node* last = nullptr;
+    size_t last_size = 0;
+    node* last_version = nullptr;
+
+    atomic_node* it = scan( guard0, [ &index, &prev, &version, &last, &last_size, &last_version ]( atomic_node* prev0, atomic_node* it, node* node0 ) {
+      if( index < node0->size ) {
+        prev = prev0;
+        version = node0;
+        return false;
+      }
+      index -= node0->size;
+      last = it;
+      last_size = node0->size;
+      last_version = node0;
+      return true;
+    }, true );
+
+    offset = index;
+
+    if( it || ! append ) return it;
+
+    offset = last_size;
+    if( last ) {
+      version = last_version;
+      return last;
+    }
+    version = head->read( guard0, []( node* node0 ) { return node0; } );
+    return head.get();
+  }
+
+  //the update of a located node is made only on the version the offset was found in: it's still
+  //the current one when the update starts, the publication then fails if it has changed
+  static bool is_current( atomic_node* it, node* version ) {
+    return it->read( []( node* node0 ) { return node0; } ) == version;
+  }
+
+  bool insert_weak( size_t index, T0 value ) {
+
+    guard guard0{ };
+
+    size_t offset;
+    atomic_node* prev;
+    node* version;
+    atomic_node* it = locate( guard0, index, offset, prev, version, true );
+
+    bool r;
+
+    if( it == head.get() ) {
+      r = it->update_weak( [ it, version, &value ]( node* node0 ) {
+        if( ! is_current( it, version ) ) return false;
+        node* node_new = new node{ };
+        node_new->data[ 0 ] = (T0&&) value;
+        node_new->size = 1;
+        node_new->next = node0->next;
+        node0->next = node_ptr{ new atomic_node{ node_new } };
+        return true;
+      } );
+    } else {
+      r = it->update_weak( [ it, version, offset, &value ]( node* node0 ) {
+
+        if( node0->locked || ! is_current( it, version ) ) return false;
+
+        uint pos = offset < node0->size ? (uint) offset : node0->size;
+
+        //split: the upper half goes to a new node
+        if( node0->size == K0 ) {
+          node* node_new = new node{ };
+          uint half = K0 / 2;
+          for( uint i = half; i < K0; i++ ) node_new->data[ i - half ] = (T0&&) node0->data[ i ];
+          node_new->size = K0 - half;
+          node_new->next = (node_ptr&&) node0->next;
+          node0->size = half;
+          node0->next = node_ptr{ new atomic_node{ node_new } };
+          if( pos > half ) {
+            insert( node_new, pos - half, value );
+            return true;
+          }
+        }
+
+        insert( node0, pos, value );
+        return true;
+      } );
+    }
+
+    if( r ) counter.add( 1 );
+
+    return r;
+  }
+
+  bool erase_weak( size_t index, T0* value = nullptr ) {
+
+    guard guard0{ };
+
+    size_t offset;
+    atomic_node* prev;
+    node* version;
+    atomic_node* it = locate( guard0, index, offset, prev, version, false );
+
+    if( ! it ) return false;
+
+    uint size_left = 0;
+
+    //a node left empty is marked in the same update
+    bool r = it->update_weak( [ it, version, offset, value, &size_left ]( node* node0 ) {
+      if( node0->locked || offset >= node0->size || ! is_current( it, version ) ) return false;
+      if( value ) *value = node0->data[ offset ];
+      for( uint i = (uint) offset; i + 1 < node0->size; i++ ) node0->data[ i ] = (T0&&) node0->data[ i + 1 ];
+      node0->data[ --node0->size ] = T0{ };
+      node0->locked = node0->size == 0;
+      size_left = node0->size;
+      return true;
+    } );
+
+    if( ! r ) return false;
+
+    counter.add( -1 );
+
+    if( size_left == 0 ) replace( prev, it );
+    else if( size_left < K0 / 4 ) merge( it, size_left );
+
+    return true;
+  }
+
+  //marks the next node if both fit in a half of a node, then merges it
+  void merge( atomic_node* it, uint size ) {
+
+    node_ptr node_next = it->read( []( node* node0 ) { return node0->locked ? node_ptr{ } : node0->next; } );
+
+    if( ! node_next ) return;
+
+    bool r = node_next->update_weak( [ size ]( node* node0 ) {
+      if( node0->locked || size + node0->size > K0 / 2 ) return false;
+      node0->locked = true;
+      return true;
+    } );
+
+    if( r ) replace( it, node_next.get() );
+  }
+
+  static void insert( node* node0, uint pos, T0& value ) {
+    for( uint i = node0->size; i > pos; i-- ) node0->data[ i ] = (T0&&) node0->data[ i - 1 ];
+    node0->data[ pos ] = (T0&&) value;
+    node0->size++;
+  }
+
+  void push_front( T0 value ) {
+    while( ! insert_weak( 0, value ) );
+  }
+
+  bool pop_front( T0* value = nullptr ) {
+    while( ! empty() ) {
+      if( erase_weak( 0, value ) ) return true;
+    }
+    return false;
+  }
+
+  template< typename U0 >
+  void for_each( U0 fn ) const {
+    for_each_node( [ &fn ]( T0 const* data, size_t size ) {
+      for( size_t i = 0; i < size; i++ ) fn( data[ i ] );
+    } );
+  }
+
+  template< typename U0 >
+  void for_each_node( U0 fn ) const {
+    guard guard0{ };
+    scan( guard0, [ &fn ]( atomic_node*, atomic_node*, node* node0 ) {
+      if( node0->size ) fn( (T0 const*) node0->data, (size_t) node0->size );
+      return true;
+    } );
+  }
+
+  size_t size() const {
+    return counter.load();
+  }
+
+  size_t size_exact() const {
+    size_t count = 0;
+    for_each_node( [ &count ]( T0 const*, size_t size ) { count += size; } );
+    return count;
+  }
+
+  bool empty() const {
+    guard guard0{ };
+    return ! scan( guard0, []( atomic_node*, atomic_node*, node* node0 ) { return node0->size == 0; } );
+  }
+
+  void clear() {
+    while( pop_front() );
+  }
+
+  node_ptr head;
+
+  sharded_counter<> counter;
+};
+
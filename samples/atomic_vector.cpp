@@ -22,6 +22,7 @@ Alexandr Poltavsky
 #include <vector>
 
 #include "atomic_data.h"
+#include "atomic_data_std.h"
 #include "atomic_data_mutex.h"
 
 namespace {
@@ -0,0 +1,120 @@
+/*
+
+A multi-megabyte array in atomic_data: a plain struct that is copied whole on every update
+against a paged_array (paged_array.h) that copies its page table and only the pages written.
+
+Threads increment random elements of the array (touch elements per update), readers sum
+a few random elements. At the end we check that the sum of all elements equals the number
+of increments.
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstdio>
+#include <chrono>
+#include <random>
+
+#include "atomic_data.h"
+#include "paged_array.h"
+
+namespace {
+
+  using uint = unsigned;
+
+  //edit to change the test setup
+  const uint array_size = 1 << 20;
+  const uint iterations = 512;
+  const uint touch = 4;
+  const uint threads_size = 8;
+
+  //test data structures
+  struct plain_array {
+    uint data[ array_size ];
+    uint const& operator[]( size_t index ) const { return data[ index ]; }
+    uint& write( size_t index ) { return data[ index ]; }
+    size_t size() const { return array_size; }
+  };
+
+  using paged_array_t = paged_array<uint, array_size>;
+
+  volatile uint global_dummy;
+
+}
+
+template< typename T > void test_paged_array( char const* name );
+
+int main() {
+
+  printf( "Test parameters:\n\tCPU: %d core(s)\n\tarray size: %u bytes\n\tupdates/thread: %d\n\telements touched/update: %d\n\tthreads: %d\n",
+    std::thread::hardware_concurrency(), (uint) sizeof( plain_array ), iterations, touch, threads_size );
+
+  test_paged_array< plain_array >( "plain array" );
+  test_paged_array< paged_array_t >( "paged_array" );
+
+}
+
+//test function
+//half of the threads update, half read, prints the time
+template< typename T >
+void test_paged_array( char const* name ) {
+
+  printf( "\nstart testing %s\n", name );
+
+  atomic_data<T, threads_size * 2> atomic_array{ new T{} };
+
+  auto update = [ &atomic_array ]() {
+    auto seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    std::mt19937_64 gen0( seed );
+    std::uniform_int_distribution<uint> engine0{ 0, array_size - 1 };
+
+    for( uint i = 0; i < iterations; i++ ) {
+      uint index[ touch ];
+      for( auto& e : index ) e = engine0( gen0 );
+      atomic_array.update( [ &index ]( T* array ) {
+        for( auto e : index ) array->write( e )++;
+        return true;
+      } );
+    }
+  };
+
+  auto read = [ &atomic_array ]() {
+    auto seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    std::mt19937_64 gen0( seed );
+    std::uniform_int_distribution<uint> engine0{ 0, array_size - 1 };
+
+    for( uint i = 0; i < iterations; i++ ) {
+      uint index = engine0( gen0 );
+      global_dummy = atomic_array.read( [ index ]( T* array ) {
+        return (*array)[ index ] + (*array)[ ( index + array_size / 2 ) % array_size ];
+      } );
+      std::this_thread::yield();
+    }
+  };
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  std::thread threads[ threads_size ];
+  for( uint i = 0; i < threads_size; i++ ) threads[ i ] = i % 2 == 0 ? std::thread{ update } : std::thread{ read };
+  for( auto& thread : threads ) thread.join();
+
+  uint time = (uint) std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+  printf( "time = %u\n", time );
+
+  uint total = iterations * touch * ( threads_size / 2 );
+
+  printf( "check that the sum of elements equals %u: ", total );
+
+  uint sum = atomic_array.read( []( T* array ) {
+    uint sum = 0;
+    for( size_t i = 0; i < array->size(); i++ ) sum += (*array)[ i ];
+    return sum;
+  } );
+
+  if( sum == total ) printf( "Passed!\n" );
+  else printf( "failed! sum = %u\n", sum );
+}
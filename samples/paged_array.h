@@ -0,0 +1,137 @@
+#pragma once
+
+/*
+
+A fixed size array of plain data with page-granular copy-on-write for atomic_data.
+
+atomic_data copies the whole data type on every update, for a multi-megabyte array that is
+a multi-megabyte copy even if the update changes a single element. paged_array keeps
+its elements in pages referenced from a page table. A copy of a paged_array copies only
+the page table (skipping the entries that already match) and shares the pages.
+Writes go through an explicit write barrier that copies a page on first write if it is
+shared with other versions, so the update cost is proportional to the pages touched.
+
+Initially all pages share a single zero page.
+
+API:
+
+create instance:
+
+  - paged_array< data_type, size, page_size = 4096 >
+  data_type must be trivially copyable, page_size is in bytes (a power of two)
+
+methods:
+
+  - data_type const& operator[]( size_t index ) const
+  read access, doesn't copy anything
+
+  - data_type& write( size_t index )
+  the write barrier: makes the page of the element private to this array and returns the element
+  the reference is valid until the array is copied to
+
+  - data_type const* read_page( size_t page_index ) const
+  - data_type* write_page( size_t page_index )
+  the same for a whole page (page_elements elements)
+
+  - size_t size()
+  number of elements
+
+usage:
+
+  atomic_data< paged_array< int, 1 << 20 > > array0;
+  array0.update( []( paged_array< int, 1 << 20 >* array1 ) { array1->write( 42 )++; return true; } );
+  int value = array0.read( []( paged_array< int, 1 << 20 >* array1 ) { return (*array1)[ 42 ]; } );
+
+License: Public-domain Software.
+
+Blog post: http://alexpolt.github.io/atomic-data.html
+Alexandr Poltavsky
+
+*/
+
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+
+#include "atomic_shared.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+
+template< typename T0, std::size_t N0, std::size_t P0 = 4096 >
+struct paged_array {
+
+  using size_t = std::size_t;
+
+  static_assert( std::is_trivially_copyable<T0>::value, "paged_array is for trivially copyable types" );
+  static_assert( P0 != 0 && ( P0 & ( P0 - 1 ) ) == 0, "Page size must be a power of two!" );
+  static_assert( sizeof( T0 ) <= P0, "Page size must be at least the size of an element" );
+
+  static const size_t page_elements = P0 / sizeof( T0 );
+  static const size_t pages_size = ( N0 + page_elements - 1 ) / page_elements;
+
+  //page data is cache line aligned
+  struct page : shared_base {
+
+    alignas( 64 ) T0 data[ page_elements ];
+
+    static void* operator new( size_t size ) {
+      void* ptr = nullptr;
+#ifdef _WIN32
+      ptr = _aligned_malloc( size, alignof( page ) );
+#else
+      if( posix_memalign( &ptr, alignof( page ), size ) ) ptr = nullptr;
+#endif
+      if( ! ptr ) throw std::bad_alloc{ };
+      return ptr;
+    }
+
+    static void operator delete( void* ptr ) {
+#ifdef _WIN32
+      _aligned_free( ptr );
+#else
+      std::free( ptr );
+#endif
+    }
+  };
+
+  using page_ref = shared_ref<page>;
+
+  paged_array() {
+    page_ref zero{ new page{} };
+    for( auto& entry : table ) entry = zero;
+  }
+
+  //copy and assignment copy the page table, shared_ref skips the entries that are already the same
+  paged_array( paged_array const& ) = default;
+  paged_array& operator=( paged_array const& ) = default;
+
+  T0 const& operator[]( size_t index ) const {
+    return table[ index / page_elements ]->data[ index % page_elements ];
+  }
+
+  T0& write( size_t index ) {
+    return write_page( index / page_elements )[ index % page_elements ];
+  }
+
+  T0 const* read_page( size_t page_index ) const {
+    return table[ page_index ]->data;
+  }
+
+  //Write Barrier
+  //a page referenced by other versions is copied before the first write
+  T0* write_page( size_t page_index ) {
+    page_ref& entry = table[ page_index ];
+    if( ! entry.unique() ) entry = page_ref{ new page( *entry ) };
+    return entry->data;
+  }
+
+  size_t size() const { return N0; }
+
+  page_ref table[ pages_size ];
+};
+